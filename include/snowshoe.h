@@ -29,11 +29,13 @@
 #ifndef CAT_SNOWSHOE_HPP
 #define CAT_SNOWSHOE_HPP
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define SNOWSHOE_VERSION 9
+#define SNOWSHOE_VERSION 10
 
 /*
  * Verify binary compatibility with the Snowshoe API on startup.
@@ -47,6 +49,33 @@ extern "C" {
 extern int _snowshoe_init(int expected_version);
 #define snowshoe_init() _snowshoe_init(SNOWSHOE_VERSION)
 
+/*
+ * Select the size of the generator point tables
+ *
+ * The built-in generator tables are about 26 KB so that they stay in L1
+ * cache.  Servers that perform a lot of snowshoe_mul_gen() operations, such
+ * as key generation and signing, or a lot of signature verification, can
+ * build larger tables at startup, trading about 132 KB of memory (L2 cache)
+ * for fewer point operations:
+ *
+ * SNOWSHOE_TABLES_SMALL: Use the built-in tables.
+ * SNOWSHOE_TABLES_LARGE: Use the larger tables, building them on first use,
+ * which takes a few milliseconds.
+ *
+ * The larger tables are read-only after they are built and shared by all
+ * threads.  They are never freed: Switching back to the small tables keeps
+ * them for calls that are still running and for a later switch back.
+ * Calls to this function must not overlap each other, so call it from one
+ * thread, usually once at startup after snowshoe_init().
+ *
+ * Returns 0 on success.
+ * Returns non-zero on failure, and the built-in tables stay in use.
+ */
+#define SNOWSHOE_TABLES_SMALL 0
+#define SNOWSHOE_TABLES_LARGE 1
+
+extern int snowshoe_init_tables(int size_class);
+
 /*
  * Mask a provided 256-bit random number so that it is less than q
  * and can be used as a secret key.
@@ -103,6 +132,24 @@ extern int snowshoe_valid(const char P[64]);
 
 extern int snowshoe_mul_gen(const char k[32], char R[64], char mul4);
 
+/*
+ * Generate n key pairs from n 32-byte random seeds
+ *
+ * k[i] = snowshoe_secret_gen(seeds[i]), P[i] = k[i]*G
+ *
+ * The results are the same as snowshoe_secret_gen() followed by
+ * snowshoe_mul_gen(k, P, 0) for each seed, but the conversions to affine
+ * coordinates share one inversion per 16 keys.  k may be the same array
+ * as seeds.
+ *
+ * Preconditions:
+ * 	n > 0
+ *
+ * Returns 0 on success.
+ * Returns non-zero if a seed gave an invalid key, which is very unlikely.
+ */
+extern int snowshoe_keygen_batch(const char seeds[][32], int n, char k[][32], char P[][64]);
+
 /*
  * R = k*4*P
  *
@@ -119,6 +166,381 @@ extern int snowshoe_mul_gen(const char k[32], char R[64], char mul4);
  */
 extern int snowshoe_mul(const char k[32], const char P[64], char R[64]);
 
+/*
+ * R[i] = k*4*P[i] for i = 0..n-1
+ *
+ * Multiply many variable points by the same k, as in multi-recipient
+ * encryption or group rekeying.  This is faster than calling
+ * snowshoe_mul() n times: the scalar is only decomposed once and
+ * the results share the final inversion.
+ *
+ * Validates input scalar k.  Validates all input points P[] before
+ * any results are written.  R may be the same array as P.
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ * 	n > 0
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_mul_many_points(const char k[32], const char P[][64], int n, char R[][64]);
+
+/*
+ * R[i] = k[i]*4*P[i]
+ *
+ * Multiply many unrelated points by their own scalars, as in a server
+ * running many key agreements at once.  The results are the same as
+ * snowshoe_mul() for each entry, but their conversions to affine
+ * coordinates share one inversion per 16 entries.
+ *
+ * Validates each input scalar k[i] and point P[i] on its own.  status[i]
+ * is set to 0 if the entry is valid, or -1 if it is not, in which case
+ * R[i] is zeroed.  Invalid entries are still evaluated in place of a
+ * fixed valid entry, so the time taken does not reveal which entries
+ * failed beyond what status[] reports.  R may be the same array as P.
+ *
+ * Preconditions:
+ * 	n > 0
+ *
+ * Returns 0 if all entries are valid.
+ * Returns non-zero if any entry is invalid.
+ * It is important to check the return value or status[] to avoid active attacks.
+ */
+extern int snowshoe_mul_batch(const char k[][32], const char P[][64], int n, char R[][64], int status[]);
+
+/*
+ * Precomputed table for multiplying one variable point by many scalars,
+ * such as a peer's long-term public key that is used in many sessions.
+ *
+ * The contents are opaque.  The table holds no secrets, so it may be
+ * shared by threads.  It holds only point coordinates and no pointers, so
+ * it is position-independent: It may be copied, saved to a file or placed
+ * in shared memory, and used by any process running a build of the
+ * library with the same SNOWSHOE_STORE_VERSION and byte order.
+ *
+ * The table must be aligned to 64 bytes, so allocate it the same way as
+ * the memory for snowshoe_fixed_base_create().  It may not be copied to
+ * memory that is not aligned.
+ */
+typedef struct {
+	unsigned long long opaque[256];
+} snowshoe_point_table;
+
+/*
+ * Validates input point P and builds its table.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if P is invalid or the table is not aligned to 64 bytes.
+ */
+extern int snowshoe_point_table_init(const char P[64], snowshoe_point_table *table);
+
+/*
+ * R = k*4*P
+ *
+ * Same as snowshoe_mul() using a table from snowshoe_point_table_init().
+ * The point was validated when the table was built.
+ *
+ * Validates input scalar k.
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if k is invalid.
+ */
+extern int snowshoe_mul_with_table(const char k[32], const snowshoe_point_table *table, char R[64]);
+
+/*
+ * Key pair for a long-lived private key
+ *
+ * Servers that use the same static key in every handshake can validate,
+ * decompose and recode it once.  The key pair also holds the public key
+ * kG and its snowshoe_point_table.
+ *
+ * The key pair holds the secret key, so it should not be copied around.
+ * Wipe it with snowshoe_keypair_destroy() when done.  It is read-only
+ * after it is built and may be shared by threads.
+ *
+ * The key pair starts with its snowshoe_point_table, so it must also be
+ * aligned to 64 bytes.
+ */
+typedef struct {
+	unsigned long long opaque[288];
+} snowshoe_keypair;
+
+/*
+ * Validates input scalar k and builds its key pair.
+ *
+ * This takes about as long as snowshoe_mul_gen() plus
+ * snowshoe_point_table_init().
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if k is invalid or kp is not aligned to 64 bytes.
+ */
+extern int snowshoe_keypair_init(const char k[32], snowshoe_keypair *kp);
+
+/*
+ * Securely erases the key pair.
+ */
+extern void snowshoe_keypair_destroy(snowshoe_keypair *kp);
+
+/*
+ * P = k*G
+ *
+ * Same as snowshoe_mul_gen(k, P, 0).
+ */
+extern void snowshoe_keypair_public(const snowshoe_keypair *kp, char P[64]);
+
+/*
+ * Returns the table for the public key P = k*G, for snowshoe_mul_with_table().
+ */
+extern const snowshoe_point_table *snowshoe_keypair_table(const snowshoe_keypair *kp);
+
+/*
+ * R = k*4*P
+ *
+ * Same as snowshoe_mul() with the key pair's private key.
+ *
+ * Validates input point P.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if P is invalid.
+ */
+extern int snowshoe_keypair_mul(const snowshoe_keypair *kp, const char P[64], char R[64]);
+
+/*
+ * R = k*4*P + b*4*Q
+ *
+ * Same as snowshoe_simul() with the key pair's private key as a.
+ *
+ * Validates input scalar b.  Validates input points P,Q.
+ *
+ * Preconditions:
+ * 	0 < b < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ */
+extern int snowshoe_keypair_simul(const snowshoe_keypair *kp, const char P[64], const char b[32], const char Q[64], char R[64]);
+
+/*
+ * Cache of peer point tables
+ *
+ * Servers that see the same peer public keys again and again can keep
+ * their snowshoe_point_table in a cache.  A hit skips validating the point
+ * and building its table, which is about 8% of snowshoe_mul().  For
+ * snowshoe_simul() a hit only skips validating the points and computing
+ * their endomorphisms, which is well under 1% of the call: Its table
+ * combines both points with the signs of both scalars, so it is still
+ * built on every call.
+ *
+ * The cache holds up to the requested number of entries (rounded up to a
+ * power of two, at most 65536) and evicts points that were not used
+ * recently.  Each entry takes about 2.3 KB.  A miss validates the point
+ * and builds its table for the next call.  Invalid points are not added.
+ *
+ * Any number of threads may use the same cache at once.  Lookups take no
+ * lock, and adding a point after a miss only locks the 4 entries it may
+ * replace.
+ *
+ * Returns the number of bytes needed for the cache.
+ * Returns 0 if entries is out of range.
+ */
+extern int snowshoe_point_cache_bytes(int entries);
+
+/*
+ * Initializes an empty cache in the provided memory, which must be aligned
+ * to 64 bytes and have room for snowshoe_point_cache_bytes(entries).
+ *
+ * Returns 0 on success.
+ * Returns non-zero if entries is out of range or the memory is misaligned.
+ */
+extern int snowshoe_point_cache_create(int entries, void *cache);
+
+/*
+ * Makes snowshoe_mul(), snowshoe_simul() and snowshoe_mul_batch() use the
+ * cache, and so snowshoe_mul_batch_parallel() and the MUL and SIMUL jobs
+ * of snowshoe_queue too.  Pass null to detach it.
+ *
+ * Like snowshoe_init_tables(), calls to this function must not overlap
+ * other calls to the library.  The cache must stay valid until it is
+ * detached.
+ */
+extern void snowshoe_point_cache_attach(void *cache);
+
+/*
+ * R = k*4*P
+ *
+ * Same as snowshoe_mul(), using and updating the cache for P.
+ *
+ * Validates input scalar k.  Validates input point P on a cache miss.
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_mul_cached(const char k[32], const char P[64], void *cache, char R[64]);
+
+/*
+ * Reads the hit and miss counters of the cache.
+ */
+extern void snowshoe_point_cache_stats(const void *cache, unsigned long long *hits, unsigned long long *misses);
+
+/*
+ * On-disk store of point tables
+ *
+ * Point tables for hot peer keys can be saved to a file, so that a
+ * restarted server maps them instead of rebuilding them.  The file is
+ * mapped read-only, so any number of processes can share it, and lookups
+ * return tables in place for snowshoe_mul_with_table().
+ *
+ * Entries are appended one at a time and have checksums.  Entries that
+ * were damaged or only partly written are skipped when the file is
+ * opened.  Tables are stored in native byte order, so files with a
+ * different SNOWSHOE_STORE_VERSION or byte order are rejected.  Files
+ * stay usable across library versions while the store version is the same.
+ *
+ * The checksums only catch accidental damage.  Protect the file like the
+ * program binary, since a forged table would give wrong results.
+ */
+typedef struct snowshoe_table_store snowshoe_table_store;
+
+/*
+ * Version of the file format, including the layout of the stored tables.
+ * It changes separately from SNOWSHOE_VERSION.
+ */
+#define SNOWSHOE_STORE_VERSION 1
+
+/*
+ * Validates input point P, builds its table and appends it to the file
+ * at path.  Creates the file if it does not exist.  Only one process
+ * should append to a file at a time.  Stores that are already open do
+ * not see the new entry.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if P is invalid, the file is from another build, or
+ * the file could not be written.
+ */
+extern int snowshoe_store_append(const char *path, const char P[64]);
+
+/*
+ * Maps the file at path read-only and indexes its entries.
+ *
+ * Returns the store on success.
+ * Returns 0 if the file is missing, unreadable or from another build.
+ */
+extern snowshoe_table_store *snowshoe_store_open(const char *path);
+
+/*
+ * Returns the table for point P, or 0 if P is not in the store.
+ * The table stays valid until the store is closed.
+ */
+extern const snowshoe_point_table *snowshoe_store_find(const snowshoe_table_store *store, const char P[64]);
+
+/*
+ * Returns the number of entries that passed their checksums.
+ */
+extern int snowshoe_store_count(const snowshoe_table_store *store);
+
+/*
+ * Unmaps the file and frees the index.
+ */
+extern void snowshoe_store_close(snowshoe_table_store *store);
+
+/*
+ * Fixed-base comb tables for long-lived points
+ *
+ * Points that are reused for a very long time, such as a server's static
+ * public key or a second generator point, can get the same comb tables as
+ * the generator point.  This brings snowshoe_fixed_base_mul() down to about
+ * the cost of snowshoe_mul_gen().
+ *
+ * size_class is SNOWSHOE_TABLES_SMALL (about 14 KB) or SNOWSHOE_TABLES_LARGE
+ * (about 84 KB).  Building a table takes about as long as 8 (small) or
+ * 13 (large) calls to snowshoe_mul().
+ *
+ * The table holds no secrets and is read-only after it is built, so it may
+ * be shared by threads.  Like snowshoe_point_table, it holds no pointers
+ * and may be copied to other 64-byte aligned memory or shared with other
+ * processes running the same build of the library.
+ *
+ * Returns the number of bytes needed for the table.
+ * Returns 0 if size_class is invalid.
+ */
+extern int snowshoe_fixed_base_bytes(int size_class);
+
+/*
+ * Validates input point P and builds its comb table in the provided
+ * memory, which must be aligned to 64 bytes and have room for
+ * snowshoe_fixed_base_bytes(size_class) bytes.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if P or size_class is invalid, or the memory is not aligned.
+ */
+extern int snowshoe_fixed_base_create(const char P[64], int size_class, void *table);
+
+/*
+ * R = k*4*P
+ *
+ * Same as snowshoe_mul() using a table from snowshoe_fixed_base_create().
+ *
+ * Validates input scalar k.
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if k is invalid.
+ */
+extern int snowshoe_fixed_base_mul(const char k[32], const void *table, char R[64]);
+
+/*
+ * R = a*4*G + b*4*P
+ *
+ * Same as snowshoe_simul_gen() using a table from snowshoe_fixed_base_create().
+ *
+ * WARNING: Not constant-time.  The input parameters a,b should be public knowledge.
+ * This is used mainly for signature verification with a well-known public key.
+ *
+ * Validates input scalars a,b.
+ *
+ * Preconditions:
+ * 	0 < a,b < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ */
+extern int snowshoe_fixed_base_simul_gen(const char a[32], const char b[32], const void *table, char R[64]);
+
+/*
+ * R = a*4*G + b*4*H
+ *
+ * Pedersen commitment to value a with blinding factor b, where H is a
+ * second generator point with a table from snowshoe_fixed_base_create().
+ * The combs for G and H are evaluated in a single constant-time pass.
+ *
+ * Nobody may know the discrete log of H with respect to G, so H should be
+ * derived by hashing to the curve rather than from a secret key.
+ *
+ * Validates input scalars a,b.
+ *
+ * Preconditions:
+ * 	0 <= a < q (prime order of curve)
+ * 	0 < b < q
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ */
+extern int snowshoe_commit(const char a[32], const char b[32], const void *H_table, char R[64]);
+
 /*
  * R = a*4*G + b*4*Q
  *
@@ -154,6 +576,171 @@ extern int snowshoe_simul_gen(const char a[32], const char b[32], const char Q[6
  */
 extern int snowshoe_simul(const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]);
 
+/*
+ * H = k*P (intermediate), for one half of a split snowshoe_simul()
+ *
+ * Validates input scalar k.  Validates input point P.
+ *
+ * snowshoe_simul() shares its doublings between both points, so it runs
+ * on one core.  When latency matters more than throughput, compute the
+ * two halves on two cores and combine them:
+ *
+ * 	Thread 1: snowshoe_simul_half(a, P, H1)
+ * 	Thread 2: snowshoe_simul_half(b, Q, H2)
+ * 	Either:   snowshoe_simul_join(H1, H2, R)
+ *
+ * R is the same as snowshoe_simul(a, P, b, Q, R).  Both functions are
+ * constant-time.  snowshoe_simul_parallel() does this on a snowshoe_pool.
+ * Applications that already have workers pinned to separate cores can
+ * call the halves themselves, so the handoff costs a cache line transfer
+ * rather than a thread wakeup.
+ *
+ * H is an extended coordinate point in native byte order that depends on
+ * the secret k.  It is only meaningful within the same process, and it
+ * should be erased after use.
+ *
+ * Preconditions:
+ * 	0 < k < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_simul_half(const char k[32], const char P[64], char H[128]);
+
+/*
+ * R = 4*H1 + 4*H2
+ *
+ * Combines the outputs of two successful snowshoe_simul_half() calls.
+ */
+extern void snowshoe_simul_join(const char H1[128], const char H2[128], char R[64]);
+
+/*
+ * R = k[0]*4*P[0] + k[1]*4*P[1] + ... + k[n-1]*4*P[n-1]
+ *
+ * Validates input scalars k[].  Validates input points P[].
+ *
+ * Preconditions:
+ * 	0 < k[i] < q (prime order of curve)
+ * 	3 <= n <= 4
+ *
+ * Simultaneously multiply n points and return the sum.
+ * For two points use snowshoe_simul().
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_simul_n(const char k[][32], const char P[][64], int n, char R[64]);
+
+/*
+ * EC-DH-FS handshake, one call per side
+ *
+ * The server holds a long-term key pair (sk_s, pp_s).  The client sends its
+ * public key pp_c, and both sides agree on h = H(pp_s, pp_e, pp_c, nonces).
+ *
+ * Server, with a fresh ephemeral private key sk_e:
+ * 	pp_e = sk_e*G
+ * 	sp = (sk_e + h*sk_s)*4*pp_c
+ *
+ * Client, after receiving pp_e:
+ * 	sp = sk_c*4*pp_e + (h*sk_c)*4*pp_s
+ *
+ * Both sides arrive at the same sp.  The server call replaces
+ * snowshoe_mul_gen(), snowshoe_mul_mod_q() and snowshoe_mul(), and it
+ * normalizes both output points with one inversion.  The client call
+ * replaces snowshoe_mul_mod_q() and snowshoe_simul().
+ *
+ * Validates input scalars sk_s, sk_e, sk_c.  Validates input points.
+ *
+ * Preconditions:
+ * 	0 < sk_s, sk_e, sk_c < q (prime order of curve)
+ *
+ * Returns 0 on success.
+ * Returns non-zero if one of the input parameters is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_dhfs_server(const char sk_s[32], const char sk_e[32], const char h[32], const char pp_c[64], char pp_e[64], char sp[64]);
+extern int snowshoe_dhfs_client(const char sk_c[32], const char h[32], const char pp_e[64], const char pp_s[64], char sp[64]);
+
+/*
+ * Extended coordinate point handles
+ *
+ * Every function above takes and returns 64-byte affine points, so each
+ * step of a longer computation pays for validating its input and for an
+ * inversion on its output.  Point handles keep a validated point in
+ * extended coordinates between calls, and only the final results are
+ * converted back with snowshoe_point_store().
+ *
+ * Handles are in native byte order and are only meaningful within the
+ * process that made them.  The output handle may be the same as an input.
+ * All of the handle functions are constant-time.
+ */
+typedef struct {
+	unsigned long long opaque[16];
+} snowshoe_point;
+
+/*
+ * Validates input point P and loads it into handle H.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if P is invalid.
+ */
+extern int snowshoe_point_load(const char P[64], snowshoe_point *H);
+
+/*
+ * R = k*G or k*4*G
+ *
+ * Same as snowshoe_mul_gen() with a handle output.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if k is invalid.
+ */
+extern int snowshoe_point_mul_gen(const char k[32], snowshoe_point *R, char mul4);
+
+/*
+ * R = k*4*P
+ *
+ * Same as snowshoe_mul() on handles.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if k is invalid.
+ */
+extern int snowshoe_point_mul(const char k[32], const snowshoe_point *P, snowshoe_point *R);
+
+/*
+ * R = a*4*P + b*4*Q
+ *
+ * Same as snowshoe_simul() on handles.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if a or b is invalid.
+ */
+extern int snowshoe_point_simul(const char a[32], const snowshoe_point *P, const char b[32], const snowshoe_point *Q, snowshoe_point *R);
+
+/*
+ * R = P + Q
+ */
+extern void snowshoe_point_add(const snowshoe_point *P, const snowshoe_point *Q, snowshoe_point *R);
+
+/*
+ * R = -P
+ */
+extern void snowshoe_point_neg(const snowshoe_point *P, snowshoe_point *R);
+
+/*
+ * R = 2*P
+ */
+extern void snowshoe_point_dbl(const snowshoe_point *P, snowshoe_point *R);
+
+/*
+ * R[i] = affine(H[i]) for i = 0..n-1
+ *
+ * Converts n handles back to 64-byte points, sharing one inversion
+ * between up to 16 points.
+ */
+extern void snowshoe_point_store(const snowshoe_point H[], int n, char R[][64]);
+
 /*
  * E = Elligator(key)
  *
@@ -165,6 +752,26 @@ extern int snowshoe_simul(const char a[32], const char P[64], const char b[32],
  */
 extern int snowshoe_elligator(const char key[32], char E[128]);
 
+/*
+ * E[i] = Elligator(keys[i])
+ *
+ * The results are the same as snowshoe_elligator() for each key, but the
+ * field inversions share one exponentiation per 16 keys, which saves about
+ * 40% of the time per key.  Each key is still processed in constant-time,
+ * so this is suitable for password-derived keys.
+ *
+ * status[i] is set to 0 on success, or -1 if key i is invalid, in which
+ * case E[i] is zeroed.
+ *
+ * Preconditions:
+ * 	n > 0
+ *
+ * Returns 0 on success.
+ * Returns non-zero if any of the keys is invalid.
+ * It is important to check the return value to avoid active attacks.
+ */
+extern int snowshoe_elligator_batch(const char keys[][32], int n, char E[][128], int status[]);
+
 /*
  * C = kG + E
  *
@@ -190,6 +797,318 @@ extern int snowshoe_elligator_encrypt(const char k[32], const char E[128], char
  */
 extern int snowshoe_elligator_secret(const char k1[32], const char C[64], const char E[128], const char k2[32], const char V[64], char R[64]);
 
+/*
+ * R = k * (C - E) + k2 * V
+ *
+ * Same as snowshoe_elligator_secret() with the key pair's private key as k1.
+ */
+extern int snowshoe_keypair_elligator_secret(const snowshoe_keypair *kp, const char C[64], const char E[128], const char k2[32], const char V[64], char R[64]);
+
+/*
+ * EdDSA signatures
+ *
+ * The secret key is 64 bytes: the secret scalar a, then the 32-byte key
+ * hi that derives the per-message nonces.  The public key is the point
+ * A = a*G.  Signatures are 96 bytes: the point R = r*4*G, then the
+ * scalar s.  Messages are hashed with BLAKE2b straight from the caller's
+ * buffer, without copying.
+ *
+ * Signing is constant-time.  Verification is not, since all of its inputs
+ * are public.
+ */
+
+/*
+ * Derives a signing key pair from a 32-byte random seed.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if the seed gave an invalid key, which is very unlikely.
+ */
+extern int snowshoe_sign_keygen(const char seed[32], char sk[64], char pk[64]);
+
+/*
+ * Signs the message msg of the given length in bytes.
+ *
+ * pk must be the public key from snowshoe_sign_keygen() for sk.  It is
+ * passed in rather than recomputed on each call.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if sk is invalid.
+ */
+extern int snowshoe_sign(const char sk[64], const char pk[64], const void *msg, size_t bytes, char sig[96]);
+
+/*
+ * Verifies the signature of the message msg of the given length in bytes.
+ *
+ * Validates input public key pk.
+ *
+ * Returns 0 if the signature is valid.
+ * Returns non-zero if the signature or public key is invalid.
+ */
+extern int snowshoe_verify(const char pk[64], const void *msg, size_t bytes, const char sig[96]);
+
+/*
+ * Scatter/gather message buffer
+ */
+typedef struct {
+	const void *data;
+	size_t bytes;
+} snowshoe_iovec;
+
+/*
+ * Same as snowshoe_sign() and snowshoe_verify() for a message that is the
+ * concatenation of the count buffers in iov.  The signature is the same as
+ * for the message in one contiguous buffer.
+ */
+extern int snowshoe_sign_iov(const char sk[64], const char pk[64], const snowshoe_iovec *iov, int count, char sig[96]);
+extern int snowshoe_verify_iov(const char pk[64], const snowshoe_iovec *iov, int count, const char sig[96]);
+
+/*
+ * Prehashed EdDSA signatures
+ *
+ * snowshoe_sign() reads the message twice, so it must be held in memory.
+ * The prehashed variant hashes the message once with BLAKE2bp-512, the
+ * 4-way parallel mode of BLAKE2b, and signs the digest, so that it can be
+ * fed in pieces as it is read.  Feeding it pieces of 512 bytes or more is
+ * fastest, since they are hashed without copying.
+ *
+ * Prehashed signatures are distinct from snowshoe_sign() signatures: one
+ * kind does not verify as the other, even for the message digest.
+ *
+ * The state holds no secrets and may be copied to fork the hash.
+ */
+typedef struct {
+	unsigned long long opaque[256];
+} snowshoe_prehash;
+
+/*
+ * Starts hashing a new message.
+ */
+extern void snowshoe_prehash_init(snowshoe_prehash *ph);
+
+/*
+ * Hashes the next bytes of the message.
+ */
+extern void snowshoe_prehash_update(snowshoe_prehash *ph, const void *data, size_t bytes);
+
+/*
+ * Finishes hashing the message and signs it.  The state must be
+ * re-initialized before it is used again.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if sk is invalid.
+ */
+extern int snowshoe_sign_prehash(const char sk[64], const char pk[64], snowshoe_prehash *ph, char sig[96]);
+
+/*
+ * Finishes hashing the message and verifies its signature.  The state must
+ * be re-initialized before it is used again.
+ *
+ * Validates input public key pk.
+ *
+ * Returns 0 if the signature is valid.
+ * Returns non-zero if the signature or public key is invalid.
+ */
+extern int snowshoe_verify_prehash(const char pk[64], snowshoe_prehash *ph, const char sig[96]);
+
+/*
+ * Thread pool for batches
+ *
+ * The _parallel functions split a batch into chunks of 16 items and run
+ * them on the calling thread and the pool's worker threads.  Idle threads
+ * steal chunks from busy ones, so the batch finishes evenly even when
+ * some threads are preempted.  The results are the same as the serial
+ * batch functions.
+ *
+ * One batch runs on a pool at a time; callers from other threads wait
+ * their turn.  Passing a null pool runs the batch on the calling thread.
+ */
+typedef struct snowshoe_pool snowshoe_pool;
+
+/*
+ * Starts a pool of threads - 1 worker threads, so that threads threads
+ * work on each batch including the caller.  Pass 0 for threads to use
+ * one thread per online processor.
+ *
+ * cpus may be null, or hold threads - 1 processor numbers to pin the
+ * worker threads to.  The calling thread is not pinned.  Pinning is done
+ * on Linux and Windows and ignored elsewhere.  threads must be given
+ * explicitly with cpus, since it is the length of the array.
+ *
+ * Returns the pool on success.
+ * Returns null if threads could not be started, a processor is invalid,
+ * or cpus is given with threads = 0.
+ */
+extern snowshoe_pool *snowshoe_pool_create(int threads, const int *cpus);
+
+/*
+ * Stops the worker threads and frees the pool.  No batch may be running.
+ */
+extern void snowshoe_pool_destroy(snowshoe_pool *pool);
+
+/*
+ * Same as snowshoe_keygen_batch(), run on the pool
+ */
+extern int snowshoe_keygen_batch_parallel(snowshoe_pool *pool, const char seeds[][32], int n, char k[][32], char P[][64]);
+
+/*
+ * Same as snowshoe_mul_batch(), run on the pool
+ */
+extern int snowshoe_mul_batch_parallel(snowshoe_pool *pool, const char k[][32], const char P[][64], int n, char R[][64], int status[]);
+
+/*
+ * Verifies n signatures, each with snowshoe_verify() for the message in
+ * msg[i], run on the pool.
+ *
+ * status[i] is set to 0 if signature i is valid, or -1 if it is not.
+ *
+ * Returns 0 if all of the signatures are valid.
+ * Returns non-zero if any signature or public key is invalid.
+ */
+extern int snowshoe_verify_batch_parallel(snowshoe_pool *pool, const char pk[][64], const snowshoe_iovec msg[], const char sig[][96], int n, int status[]);
+
+/*
+ * Same as snowshoe_simul(), with the two halves from snowshoe_simul_half()
+ * run on the calling thread and one worker of the pool, and then joined.
+ *
+ * This lowers the latency of one snowshoe_simul() on an idle pool, for
+ * about 40% more total work.  The second half is handed to the worker
+ * directly, without waiting for batches to finish.  If the worker is busy
+ * with a batch, the caller runs both halves itself.  One call at a time
+ * uses the worker, and concurrent calls run serially.
+ *
+ * With a null pool or a pool of one thread it falls back to snowshoe_simul().
+ */
+extern int snowshoe_simul_parallel(snowshoe_pool *pool, const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]);
+
+/*
+ * Asynchronous job queue
+ *
+ * For event-loop servers that must not stall on a multiplication.  Jobs
+ * are submitted without blocking, run on the queue's worker threads, and
+ * collected with snowshoe_poll().  Workers run MUL jobs that are waiting
+ * together in batches, so a busy queue also gets more throughput.
+ *
+ * snowshoe_queue_fd() gives a descriptor for select/poll/epoll that is
+ * readable while finished jobs are waiting to be collected.
+ */
+typedef struct snowshoe_queue snowshoe_queue;
+
+enum {
+	SNOWSHOE_OP_MUL_GEN = 1, /* R = a*G, as snowshoe_mul_gen(a, R, 0) */
+	SNOWSHOE_OP_MUL = 2, /* R = a*4*P, as snowshoe_mul(a, P, R) */
+	SNOWSHOE_OP_SIMUL = 3 /* R = a*4*P + b*4*Q, as snowshoe_simul(a, P, b, Q, R) */
+};
+
+/*
+ * A job is owned by the queue from snowshoe_submit() until snowshoe_poll()
+ * returns it, and must not be touched or freed in between.
+ *
+ * Fill in op and the inputs it uses.  user is not used by the library.
+ * On completion, result is 0 on success, or non-zero if an input was
+ * invalid, and R holds the output.
+ */
+typedef struct {
+	int op;
+	int result;
+	void *user;
+	char a[32], b[32];
+	char P[64], Q[64];
+	char R[64];
+} snowshoe_job;
+
+/*
+ * Starts a queue with the given number of worker threads, or one per
+ * online processor for 0.  At most capacity jobs may be in the queue,
+ * counting from submission until they are collected.
+ *
+ * Returns the queue on success.
+ * Returns null if the parameters are out of range or threads could not
+ * be started.
+ */
+extern snowshoe_queue *snowshoe_queue_create(int threads, int capacity);
+
+/*
+ * Finishes the jobs that were submitted, stops the worker threads and
+ * frees the queue.  Jobs that were not collected are not touched again.
+ */
+extern void snowshoe_queue_destroy(snowshoe_queue *queue);
+
+/*
+ * Returns the descriptor that is readable while finished jobs are
+ * waiting, or -1 on Windows where there is none.  Do not read from it or
+ * close it; snowshoe_poll() resets it.
+ */
+extern int snowshoe_queue_fd(const snowshoe_queue *queue);
+
+/*
+ * Adds a job to the queue.  Does not block.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if the queue is at capacity.
+ */
+extern int snowshoe_submit(snowshoe_queue *queue, snowshoe_job *job);
+
+/*
+ * Collects up to max finished jobs into done[].  Does not block.
+ *
+ * Returns the number of jobs collected.
+ */
+extern int snowshoe_poll(snowshoe_queue *queue, snowshoe_job *done[], int max);
+
+/*
+ * Ephemeral key pair pool
+ *
+ * Handshakes that start with a fresh key pair (EC-DH-FS, or
+ * snowshoe_elligator_encrypt()) can take a precomputed (k, k*G) pair from
+ * the pool instead of running snowshoe_mul_gen() on the critical path.
+ * A background thread refills the pool to capacity with
+ * snowshoe_keygen_batch() whenever it falls to low_water pairs.
+ *
+ * The library has no random source of its own, so the pool calls rng to
+ * fill seed buffers.  It is called from the background thread and from
+ * snowshoe_ephemeral_pop(), so it must be thread-safe.  It returns 0 on
+ * success.  If it fails, the background thread stops refilling.
+ */
+typedef int (*snowshoe_random)(void *context, char *buf, int bytes);
+
+typedef struct snowshoe_ephemeral snowshoe_ephemeral;
+
+/*
+ * Starts a pool that holds up to capacity pairs and begins filling it.
+ *
+ * Preconditions:
+ * 	0 < capacity <= 65536
+ * 	0 <= low_water < capacity
+ *
+ * Returns the pool on success.
+ * Returns null if the parameters are out of range or the thread could
+ * not be started.
+ */
+extern snowshoe_ephemeral *snowshoe_ephemeral_create(int capacity, int low_water, snowshoe_random rng, void *context);
+
+/*
+ * Stops the background thread, erases the unused pairs and frees the pool.
+ */
+extern void snowshoe_ephemeral_destroy(snowshoe_ephemeral *pool);
+
+/*
+ * Takes a key pair: k is a private key and P = k*G, as from
+ * snowshoe_secret_gen() and snowshoe_mul_gen(k, P, 0).  The pair is erased
+ * from the pool.  If the pool is empty, the pair is generated in the
+ * calling thread.  Any number of threads may pop at once, and a pop only
+ * takes a lock to wake the background thread at the low-water mark.
+ *
+ * Returns 0 on success.
+ * Returns non-zero if the pool was empty and rng failed.
+ */
+extern int snowshoe_ephemeral_pop(snowshoe_ephemeral *pool, char k[32], char P[64]);
+
+/*
+ * Number of pops served from the pool and generated in the caller, for
+ * tuning capacity and low_water.
+ */
+extern void snowshoe_ephemeral_stats(snowshoe_ephemeral *pool, unsigned long long *hits, unsigned long long *misses);
+
 #ifdef __cplusplus
 }
 #endif
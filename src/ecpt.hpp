@@ -3,6 +3,11 @@
 
 #include "fe.hpp"
 
+#if defined(__AVX2__) && defined(CAT_WORD_64)
+# define CAT_SNOWSHOE_AVX2 /* This flag is used by the rest of the code */
+# include <immintrin.h>
+#endif
+
 namespace cat {
 
 
@@ -59,6 +64,14 @@ typedef u64 vec_ecpt CAT_VECTOR_SIZE(u64, 4*4);
 
 #endif
 
+/*
+ * When the compiler targets AVX2 (e.g. -mavx2), the constant-time table
+ * lookups in ec_select() and ec_select_affine() stream each table entry
+ * through full-width loads and blend it in with a compare mask instead,
+ * which replaces the vector extension path for those scans.  All tables
+ * are 64-byte aligned so that each affine entry is exactly one cache line.
+ */
+
 static const u32 EC_D = 109;
 
 
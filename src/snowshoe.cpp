@@ -43,8 +43,25 @@
  */
 
 #include "ecmul.inc"
+#include "blake2b.inc"
 #include "snowshoe.h"
 
+#include <cstdio>
+#include <new>
+
+#if defined(CAT_OS_WINDOWS)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
 #ifndef CAT_ENDIAN_LITTLE
 
 #include "SecureErase.hpp"
@@ -242,6 +259,47 @@ static bool mul_mod_q_test() {
 	return true;
 }
 
+static bool blake2b_test() {
+	static const u8 expected[BLAKE2B_OUTBYTES] = {
+		0xBA, 0x80, 0xA5, 0x3F, 0x98, 0x1C, 0x4D, 0x0D, 0x6A, 0x27, 0x97, 0xB6, 0x9F, 0x12, 0xF6, 0xE9,
+		0x4C, 0x21, 0x2F, 0x14, 0x68, 0x5A, 0xC4, 0xB7, 0x4B, 0x12, 0xBB, 0x6F, 0xDB, 0xFF, 0xA2, 0xD1,
+		0x7D, 0x87, 0xC5, 0x39, 0x2A, 0xAB, 0x79, 0x2D, 0xC2, 0x52, 0xD5, 0xDE, 0x45, 0x33, 0xCC, 0x95,
+		0x18, 0xD3, 0x8A, 0xA8, 0xDB, 0xF1, 0x92, 0x5A, 0xB9, 0x23, 0x86, 0xED, 0xD4, 0x00, 0x99, 0x23
+	};
+
+	// BLAKE2b-512("abc")
+	blake2b_state S;
+	u8 digest[BLAKE2B_OUTBYTES];
+	blake2b_init(S, BLAKE2B_OUTBYTES);
+	blake2b_update(S, "abc", 3);
+	blake2b_final(S, digest);
+
+	return memcmp(digest, expected, BLAKE2B_OUTBYTES) == 0;
+}
+
+static bool blake2bp_test() {
+	static const u8 expected[BLAKE2B_OUTBYTES] = {
+		0x21, 0x7E, 0x4A, 0x46, 0xE6, 0x1F, 0xF8, 0x39, 0xB2, 0x02, 0x06, 0x97, 0xBD, 0x92, 0xD3, 0xA8,
+		0xD4, 0x24, 0xE4, 0xD6, 0xF5, 0x10, 0xE9, 0x95, 0x6E, 0x3B, 0x9E, 0x63, 0xEA, 0x8C, 0x9E, 0x89,
+		0x86, 0x01, 0x2D, 0x54, 0xC6, 0x53, 0x8A, 0x25, 0x9D, 0x15, 0xB4, 0xCB, 0xF8, 0xA5, 0xE3, 0xA5,
+		0xCC, 0xDB, 0x2D, 0x1A, 0x6A, 0x5E, 0x26, 0x72, 0x46, 0xF6, 0x83, 0xA8, 0x11, 0xC7, 0x10, 0x7E
+	};
+
+	// BLAKE2bp-512 of 1000 bytes (7 * i), which ends part way through a leaf
+	u8 msg[1000];
+	for (int ii = 0; ii < 1000; ++ii) {
+		msg[ii] = (u8)(ii * 7);
+	}
+
+	blake2bp_state S;
+	u8 digest[BLAKE2B_OUTBYTES];
+	blake2bp_init(S);
+	blake2bp_update(S, msg, sizeof(msg));
+	blake2bp_final(S, digest);
+
+	return memcmp(digest, expected, BLAKE2B_OUTBYTES) == 0;
+}
+
 /*
  * The purpose of this is to mainly verify that the base Fp field operations
  * are working properly.  Most of the rest of the code hinges on these working.
@@ -263,356 +321,3700 @@ static bool self_test() {
 		return false;
 	}
 
+	if (!blake2b_test()) {
+		return false;
+	}
+
+	if (!blake2bp_test()) {
+		return false;
+	}
+
 	return true;
 }
 
-#ifdef __cplusplus
-extern "C" {
-#endif
 
-int _snowshoe_init(int expected_version) {
-	// If math object is aligned oddly.
-	if (sizeof(ecpt_affine) != 64) {
-		return -1;
-	}
+//// Runtime-built Tables
 
-	if (sizeof(ecpt) != 128) {
-		return -1;
-	}
+/*
+ * The large tables are allocated in whole pages so that they can be made
+ * read-only once they are built.  They are shared by all threads.
+ *
+ * Once published, the tables are kept until the process exits: other
+ * threads may still be reading them after a switch back to the built-in
+ * tables, and a later switch to the large tables reuses them.
+ */
 
-	if (sizeof(ufp) != 16) {
-		return -1;
-	}
+static const int LARGE_TABLES_BYTES = GEN_TABLE_LARGE_BYTES + WNAF_GEN_TABLE_LARGE_BYTES;
 
-	if (sizeof(ufe) != 32) {
-		return -1;
-	}
+static void *m_large_tables = 0;
 
-	if (!self_test()) {
-		return -1;
-	}
+static void *tables_alloc(int bytes) {
+#if defined(CAT_OS_WINDOWS)
+	return VirtualAlloc(0, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	void *mem = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	return (mem == MAP_FAILED) ? 0 : mem;
+#endif
+}
 
-	return (expected_version == SNOWSHOE_VERSION) ? 0 : -1;
+static bool tables_protect(void *mem, int bytes) {
+#if defined(CAT_OS_WINDOWS)
+	DWORD old;
+	return VirtualProtect(mem, bytes, PAGE_READONLY, &old) != 0;
+#else
+	return mprotect(mem, bytes, PROT_READ) == 0;
+#endif
 }
 
-void snowshoe_secret_gen(char k_chars[32]) {
-	// Operate on input in-place to avoid making waste variables
-	u64 *kq = (u64 *)k_chars;
+static void tables_free(void *mem, int bytes) {
+#if defined(CAT_OS_WINDOWS)
+	VirtualFree(mem, 0, MEM_RELEASE);
+#else
+	munmap(mem, bytes);
+#endif
+}
 
-#ifndef CAT_ENDIAN_LITTLE
-	ec_load_k(k_chars, kq);
-#endif // CAT_ENDIAN_LITTLE
 
-	ec_mask_scalar(kq);
+//// Table Store
 
-#ifndef CAT_ENDIAN_LITTLE
-	ec_save_k(kq, k_chars);
-#endif // CAT_ENDIAN_LITTLE
-}
+/*
+ * Point tables can be saved to a file that any number of processes map
+ * read-only, so a restarted server does not have to rebuild the tables
+ * for its hot peer keys.
+ *
+ * The file is a 64-byte header followed by fixed-size entries that are
+ * only ever appended.  A partial entry at the end, from a crash during an
+ * append, is ignored.  Each entry has a checksum, and entries that fail it
+ * are skipped when the file is opened.  Tables are stored in the native
+ * format, so the header records the store format and byte order, and
+ * files with a different format are rejected.  The library version that
+ * wrote the file is only recorded for diagnostics.
+ *
+ * The checksum only catches accidental corruption.  The file must be
+ * protected like the program itself, since a forged table would produce
+ * wrong results.
+ */
 
-void snowshoe_mul_mod_q(const char x[32], const char y[32], const char z[32], char r[32]) {
-#ifndef CAT_ENDIAN_LITTLE
-	u64 x1[4+4+4];
-	u64 *y1 = x1 + 4;
-	u64 *z1 = x1 + 8;
+// Hash of a serialized point, mixing the coordinates so that points sharing x or y spread out
+static CAT_INLINE u64 ec_point_hash(const u64 key[8]) {
+	u64 h = key[0] ^ (key[4] * 0x9E3779B97F4A7C15ULL);
+	return h ^ (h >> 29);
+}
 
-	ec_load_k(x, x1);
-	ec_load_k(y, y1);
-	if (z) {
-		ec_load_k(z, z1);
-	}
+static const u64 STORE_MAGIC = 0x4C4254574F4E53ULL; // "SNOWTBL"
+static const u32 STORE_FORMAT = SNOWSHOE_STORE_VERSION;
+static const u32 STORE_ENDIAN = 0x01020304;
+static const u32 STORE_MAX_ENTRIES = 1 << 24;
+
+struct store_header {
+	u64 magic; // STORE_MAGIC
+	u32 format; // STORE_FORMAT
+	u32 version; // SNOWSHOE_VERSION that wrote the file, not checked
+	u32 entry_bytes; // sizeof(store_entry)
+	u32 endian; // STORE_ENDIAN in native byte order
+	u64 pad[5];
+};
 
-	mul_mod_q(x1, y1, z ? z1 : 0, x1);
+struct store_entry {
+	u64 key[8]; // Serialized point
+	u64 check; // Checksum of key and table
+	u64 pad[7];
+	ec_point_table table;
+};
 
-	ec_save_k(x1, r);
+struct store_handle {
+	const u8 *map;
+	u64 map_bytes;
+	const store_entry *entries;
+	u32 count; // Number of entries that passed the checksum
+	u32 mask; // Index size - 1
+	u32 *index; // Hash index: Entry number + 1, or 0 if empty
+};
 
-	CAT_SECURE_OBJCLR(x1);
-#else
-	mul_mod_q((const u64 *)x, (const u64 *)y, (const u64 *)z, (u64 *)r);
-#endif // CAT_ENDIAN_LITTLE
+static void store_header_init(store_header &h) {
+	CAT_OBJCLR(h);
+	h.magic = STORE_MAGIC;
+	h.format = STORE_FORMAT;
+	h.version = SNOWSHOE_VERSION;
+	h.entry_bytes = sizeof(store_entry);
+	h.endian = STORE_ENDIAN;
 }
 
-void snowshoe_add_mod_q(const char x[32], const char y[32], char r[32]) {
-#ifndef CAT_ENDIAN_LITTLE
-	u64 x1[4+4];
-	u64 *y1 = x1 + 4;
-
-	ec_load_k(x, x1);
-	ec_load_k(y, y1);
+static bool store_header_ok(const store_header &h) {
+	return h.magic == STORE_MAGIC && h.format == STORE_FORMAT &&
+		   h.entry_bytes == sizeof(store_entry) && h.endian == STORE_ENDIAN;
+}
 
-	add_mod_q(x1, y1, x1);
+// 64-bit FNV-1a over the words of the key and table
+static u64 store_checksum(const store_entry &e) {
+	const u64 *table = (const u64 *)&e.table;
+	u64 h = 0xCBF29CE484222325ULL;
 
-	ec_save_k(x1, r);
+	for (int ii = 0; ii < 8; ++ii) {
+		h = (h ^ e.key[ii]) * 0x100000001B3ULL;
+	}
+	for (int ii = 0; ii < (int)(sizeof(e.table) / sizeof(u64)); ++ii) {
+		h = (h ^ table[ii]) * 0x100000001B3ULL;
+	}
 
-	CAT_SECURE_OBJCLR(x1);
-#else
-	add_mod_q((const u64 *)x, (const u64 *)y, (u64 *)r);
-#endif // CAT_ENDIAN_LITTLE
+	return h;
 }
 
-void snowshoe_mod_q(const char x[64], char r[32]) {
-#ifndef CAT_ENDIAN_LITTLE
-	u64 x1[8];
+static const u8 *store_map(const char *path, u64 &bytes) {
+#if defined(CAT_OS_WINDOWS)
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
 
-	const u64 *k_raw = reinterpret_cast<const u64 *>( x );
-	x1[0] = getLE(k_raw[0]);
-	x1[1] = getLE(k_raw[1]);
-	x1[2] = getLE(k_raw[2]);
-	x1[3] = getLE(k_raw[3]);
-	x1[4] = getLE(k_raw[4]);
-	x1[5] = getLE(k_raw[5]);
-	x1[6] = getLE(k_raw[6]);
-	x1[7] = getLE(k_raw[7]);
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(store_header)) {
+		CloseHandle(file);
+		return 0;
+	}
 
-	mod_q(x1, x1);
+	// The view stays valid after the handles are closed
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(file);
+	if (!mapping) {
+		return 0;
+	}
 
-	ec_save_k(x1, r);
+	void *mem = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!mem) {
+		return 0;
+	}
 
-	CAT_SECURE_OBJCLR(x1);
+	bytes = (u64)size.QuadPart;
+	return (const u8 *)mem;
 #else
-	mod_q((const u64 *)x, (u64 *)r);
-#endif // CAT_ENDIAN_LITTLE
-}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
 
-void snowshoe_neg(const char P[64], char R[64]) {
-#ifndef CAT_ENDIAN_LITTLE
-	// Load point
-	ecpt_affine p1;
-	ec_load_xy((const u8 *)P, p1);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(store_header)) {
+		close(fd);
+		return 0;
+	}
 
-	// Run the math routine
-	ec_neg_affine(p1, p1);
+	// The mapping stays valid after the file is closed
+	void *mem = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		return 0;
+	}
 
-	// Save result endian-neutral
-	ec_save_xy(p1, (u8 *)R);
+	bytes = (u64)st.st_size;
+	return (const u8 *)mem;
+#endif
+}
 
-	CAT_SECURE_OBJCLR(p1); // Maybe unnecessary for all use cases
+static void store_unmap(const u8 *map, u64 bytes) {
+#if defined(CAT_OS_WINDOWS)
+	UnmapViewOfFile(map);
 #else
-	ec_neg_affine(*(const ecpt_affine *)P, *(ecpt_affine *)R);
-#endif // CAT_ENDIAN_LITTLE
+	munmap((void *)map, bytes);
+#endif
 }
 
-int snowshoe_valid(const char P[64]) {
-#ifndef CAT_ENDIAN_LITTLE
-	// Load point
-	ecpt_affine p1;
-	ec_load_xy((const u8*)P, p1);
+//// EdDSA Signatures
 
-	// If point is invalid,
-	if (!ec_valid_vartime(p1)) {
-		return -1;
+/*
+ * Key generation:
+ * 	hi,lo = H(seed)
+ * 	a = snowshoe_secret_gen(lo)
+ * 	A = a*G
+ * 	Secret key = a,hi  Public key = A
+ *
+ * Sign message M:
+ * 	r = H(hi,M) (mod q)
+ * 	R = r*4*G
+ * 	t = H(R,Ax,M) (mod q)
+ * 	s = r + t*a (mod q)
+ * 	Signature = R,s
+ *
+ * Verify:
+ * 	u = H(R,Ax,M) (mod q)
+ * 	R =?= s*4*G + u*4*(-A)
+ *
+ * H is BLAKE2b-512, and each hash reads M in place, so M may be scattered
+ * over several buffers.  Ax is the x coordinate of A, the first 32 bytes of
+ * the public key, as in supercop/crypto_sign/snowshoe/ref/sign.c.
+ *
+ * The prehashed variant signs the digest D = BLAKE2bp-512(M) in place of M,
+ * so that M is read only once and can be streamed.  BLAKE2bp is used there
+ * since prehashing is for long messages.  Its r and t hashes use BLAKE2b
+ * personalized with SIGN_PREHASH_PERSONAL, so that a prehashed signature
+ * never shares a nonce or a challenge with a signature of the message D.
+ */
+
+static const u8 SIGN_PREHASH_PERSONAL[16] = {
+	'S', 'n', 'o', 'w', 's', 'h', 'o', 'e', 'E', 'd', 'D', 'S', 'A', 'p', 'h', 0
+};
+
+static void sign_hash_init(blake2b_state &S, const u8 *personal) {
+	if (personal) {
+		blake2b_init_personal(S, BLAKE2B_OUTBYTES, personal);
+	} else {
+		blake2b_init(S, BLAKE2B_OUTBYTES);
+	}
+}
+
+static void sign_hash_iov(blake2b_state &S, const snowshoe_iovec *iov, int count) {
+	for (int ii = 0; ii < count; ++ii) {
+		blake2b_update(S, iov[ii].data, iov[ii].bytes);
 	}
+}
 
-	CAT_SECURE_OBJCLR(p1); // Maybe unnecessary for all use cases
-#else
-	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
-		return -1;
+// r = H(S) (mod q)
+static void sign_hash_mod_q(blake2b_state &S, u64 r[4]) {
+	u64 digest[8];
+	blake2b_final(S, (u8 *)digest);
+
+	for (int ii = 0; ii < 8; ++ii) {
+		digest[ii] = getLE64(digest[ii]);
 	}
-#endif // CAT_ENDIAN_LITTLE
 
-	return 0;
+	mod_q(digest, r);
+
+	CAT_SECURE_OBJCLR(digest);
 }
 
-int snowshoe_mul_gen(const char k_raw[32], char R[64], char mul4) {
+static int sign_iov(const char sk[64], const char pk[64], const snowshoe_iovec *iov, int count, const u8 *personal, char sig[96]) {
+	u64 a[4], r[4], t[4];
+	blake2b_state S;
+
 #ifndef CAT_ENDIAN_LITTLE
-	u64 k[4];
-	ec_load_k(k_raw, k);
+	ec_load_k(sk, a);
+#else
+	memcpy(a, sk, 32);
+#endif // CAT_ENDIAN_LITTLE
 
 	// Validate key
-	if (invalid_key(k)) {
+	if (invalid_key(a)) {
 		return -1;
 	}
 
-	// R = [4]kG
-	ecpt_affine r;
-	ecpt p;
-	ufe p2b;
-	ec_mul_gen(k, p, p2b);
-	if (mul4 != 0) {
-		ec_dbl(p, p, false, p2b);
-		ec_dbl(p, p, false, p2b);
-	}
-	ec_affine(p, r);
+	// r = H(hi,M) (mod q)
+	sign_hash_init(S, personal);
+	blake2b_update(S, sk + 32, 32);
+	sign_hash_iov(S, iov, count);
+	sign_hash_mod_q(S, r);
 
-	// Save result endian-neutral
-	ec_save_xy(r, (u8*)R);
+	// R = r*4*G
+	ecpt X;
+	ufe t2b;
+	ec_mul_gen(r, X, t2b);
+	ec_dbl(X, X, false, t2b);
+	ec_dbl(X, X, false, t2b);
 
-	CAT_SECURE_OBJCLR(k);
-	CAT_SECURE_OBJCLR(r);
+#ifndef CAT_ENDIAN_LITTLE
+	ecpt_affine R;
+	ec_affine(X, R);
+	ec_save_xy(R, (u8*)sig);
 #else
-	const u64 *k = (const u64 *)k_raw;
+	ec_affine(X, *(ecpt_affine *)sig);
+#endif // CAT_ENDIAN_LITTLE
 
-	// Validate key
-	if (invalid_key(k)) {
-		return -1;
-	}
+	// t = H(R,Ax,M) (mod q)
+	sign_hash_init(S, personal);
+	blake2b_update(S, sig, 64);
+	blake2b_update(S, pk, 32);
+	sign_hash_iov(S, iov, count);
+	sign_hash_mod_q(S, t);
 
-	// R = [4]kG
-	ecpt p;
-	ufe p2b;
-	ec_mul_gen(k, p, p2b);
-	if (mul4 != 0) {
-		ec_dbl(p, p, false, p2b);
-		ec_dbl(p, p, false, p2b);
-	}
-	ec_affine(p, *(ecpt_affine *)R);
+	// s = r + t*a (mod q)
+	mul_mod_q(t, a, r, t);
+
+#ifndef CAT_ENDIAN_LITTLE
+	ec_save_k(t, sig + 64);
+#else
+	memcpy(sig + 64, t, 32);
 #endif // CAT_ENDIAN_LITTLE
 
+	CAT_SECURE_OBJCLR(a);
+	CAT_SECURE_OBJCLR(r);
+	CAT_SECURE_OBJCLR(S);
+	CAT_SECURE_OBJCLR(X);
+
 	return 0;
 }
 
-int snowshoe_mul(const char k_raw[32], const char P[64], char R[64]) {
+static int verify_iov(const char pk[64], const snowshoe_iovec *iov, int count, const u8 *personal, const char sig[96]) {
+	u64 s[4], u[4];
+	ecpt_affine A, R;
+
 #ifndef CAT_ENDIAN_LITTLE
-	u64 k[4];
-	ec_load_k(k_raw, k);
+	ec_load_k(sig + 64, s);
+	ec_load_xy((const u8*)pk, A);
 
-	// Validate key
-	if (invalid_key(k)) {
+	// Validate public key
+	if (!ec_valid(A)) {
 		return -1;
 	}
+#else
+	memcpy(s, sig + 64, 32);
+	A = *(const ecpt_affine *)pk;
 
-	// Load point
-	ecpt_affine p1, r;
-	ec_load_xy((const u8*)P, p1);
+	// Validate public key
+	if (!ec_valid_vartime(A)) {
+		return -1;
+	}
+#endif // CAT_ENDIAN_LITTLE
 
-	// Validate point
-	if (!ec_valid(p1)) {
+	// Validate s
+	if (invalid_key(s)) {
 		return -1;
 	}
 
-	// Multiply
-	ec_mul_affine(k, p1, r);
+	// u = H(R,Ax,M) (mod q)
+	blake2b_state S;
+	sign_hash_init(S, personal);
+	blake2b_update(S, sig, 64);
+	blake2b_update(S, pk, 32);
+	sign_hash_iov(S, iov, count);
+	sign_hash_mod_q(S, u);
 
-	// Save result endian-neutral
-	ec_save_xy(r, (u8*)R);
+	if (invalid_key(u)) {
+		return -1;
+	}
 
-	CAT_SECURE_OBJCLR(k);
-	CAT_SECURE_OBJCLR(p1);
-	CAT_SECURE_OBJCLR(r);
-#else
-	const u64 *k = (const u64 *)k_raw;
+	// R = s*4*G + u*4*(-A)
+	ec_neg_affine(A, A);
+	ec_simul_gen_wnaf_affine(s, u, A, R);
 
-	// Validate key
-	if (invalid_key(k)) {
+	// Compare with the signature (does not need to be constant-time)
+#ifndef CAT_ENDIAN_LITTLE
+	u8 Rs[64];
+	ec_save_xy(R, Rs);
+	if (memcmp(Rs, sig, 64) != 0) {
 		return -1;
 	}
-
-	// Validate point
-	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
+#else
+	if (memcmp(&R, sig, 64) != 0) {
 		return -1;
 	}
-
-	// Multiply
-	ec_mul_affine(k, *(const ecpt_affine *)P, *(ecpt_affine *)R);
 #endif // CAT_ENDIAN_LITTLE
 
 	return 0;
 }
 
-int snowshoe_simul_gen(const char a[32], const char b[32], const char Q[64], char R[64]) {
-#ifndef CAT_ENDIAN_LITTLE
-	u64 k1[4+4];
-	u64 *k2 = k1 + 4;
-	ec_load_k(a, k1);
-	ec_load_k(b, k2);
+//// Thread Pool
+
+/*
+ * Worker threads for the _parallel batch functions
+ *
+ * The calling thread and the workers split a batch into chunks of
+ * POOL_CHUNK items, so each chunk still shares one inversion in the
+ * batch code.  Each thread starts with an even share of the chunks and
+ * takes them from the front of its share.  When its share runs out it
+ * steals the back half of another thread's share, so threads that were
+ * slow to start or were preempted do not hold up the batch.
+ *
+ * All of the tables are read-only once built, so the threads share them.
+ * One batch runs on a pool at a time, and other callers wait for it.
+ *
+ * snowshoe_simul_parallel() hands one half of its work to worker 1
+ * through a separate slot instead, since going through the batch locks
+ * and a broadcast costs a large part of the half it saves.  Worker 1
+ * spins on the slot for a while after each job before it sleeps, so back
+ * to back calls do not wait for a wakeup.  If worker 1 is busy with a
+ * batch, the caller takes the half back and runs it itself.
+ */
+
+static const int POOL_CHUNK = EC_MUL_MANY_CHUNK;
+static const int POOL_MAX_THREADS = 1024;
+
+#if defined(CAT_OS_WINDOWS)
+typedef CRITICAL_SECTION pool_mutex;
+typedef CONDITION_VARIABLE pool_cond;
+typedef HANDLE pool_thread;
+#else
+typedef pthread_mutex_t pool_mutex;
+typedef pthread_cond_t pool_cond;
+typedef pthread_t pool_thread;
+#endif
+
+static void pool_mutex_init(pool_mutex &m) {
+#if defined(CAT_OS_WINDOWS)
+	InitializeCriticalSection(&m);
+#else
+	pthread_mutex_init(&m, 0);
+#endif
+}
+
+static void pool_mutex_destroy(pool_mutex &m) {
+#if defined(CAT_OS_WINDOWS)
+	DeleteCriticalSection(&m);
+#else
+	pthread_mutex_destroy(&m);
+#endif
+}
+
+static CAT_INLINE void pool_lock(pool_mutex &m) {
+#if defined(CAT_OS_WINDOWS)
+	EnterCriticalSection(&m);
+#else
+	pthread_mutex_lock(&m);
+#endif
+}
+
+static CAT_INLINE void pool_unlock(pool_mutex &m) {
+#if defined(CAT_OS_WINDOWS)
+	LeaveCriticalSection(&m);
+#else
+	pthread_mutex_unlock(&m);
+#endif
+}
+
+static void pool_cond_init(pool_cond &c) {
+#if defined(CAT_OS_WINDOWS)
+	InitializeConditionVariable(&c);
+#else
+	pthread_cond_init(&c, 0);
+#endif
+}
+
+static void pool_cond_destroy(pool_cond &c) {
+#if defined(CAT_OS_WINDOWS)
+	(void)c;
+#else
+	pthread_cond_destroy(&c);
+#endif
+}
+
+static CAT_INLINE void pool_wait(pool_cond &c, pool_mutex &m) {
+#if defined(CAT_OS_WINDOWS)
+	SleepConditionVariableCS(&c, &m, INFINITE);
+#else
+	pthread_cond_wait(&c, &m);
+#endif
+}
+
+static CAT_INLINE void pool_wake_one(pool_cond &c) {
+#if defined(CAT_OS_WINDOWS)
+	WakeConditionVariable(&c);
+#else
+	pthread_cond_signal(&c);
+#endif
+}
+
+static CAT_INLINE void pool_wake_all(pool_cond &c) {
+#if defined(CAT_OS_WINDOWS)
+	WakeAllConditionVariable(&c);
+#else
+	pthread_cond_broadcast(&c);
+#endif
+}
+
+static int pool_cpu_count() {
+#if defined(CAT_OS_WINDOWS)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+#if defined(CAT_OS_WINDOWS)
+typedef DWORD (WINAPI *pool_entry)(void *arg);
+#else
+typedef void *(*pool_entry)(void *arg);
+#endif
+
+static bool pool_thread_start(pool_thread &thread, pool_entry entry, void *arg) {
+#if defined(CAT_OS_WINDOWS)
+	thread = CreateThread(0, 0, entry, arg, 0, 0);
+	return thread != 0;
+#else
+	return pthread_create(&thread, 0, entry, arg) == 0;
+#endif
+}
+
+static void pool_thread_join(pool_thread &thread) {
+#if defined(CAT_OS_WINDOWS)
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, 0);
+#endif
+}
+
+// Pins a thread to one processor.  Only supported on Linux and Windows
+static bool pool_set_affinity(pool_thread thread, const int cpu) {
+#if defined(CAT_OS_WINDOWS)
+	if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+		return false;
+	}
+	return SetThreadAffinityMask(thread, (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+#else
+	(void)thread;
+	return cpu >= 0;
+#endif
+}
+
+/*
+ * Atomics for the lock-free paths
+ *
+ * These are sequentially consistent, which keeps the ordering arguments
+ * simple, except for the _acquire and _release variants that publish ring
+ * cells.  They are only used on shared counters, rings and handoff states,
+ * not in the math.  Compilers without the __atomic builtins get a volatile
+ * access between full barriers instead.
+ */
+
+static CAT_INLINE void pool_fence() {
+#if defined(CAT_OS_WINDOWS)
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+static CAT_INLINE u32 pool_load(volatile u32 &x) {
+#if defined(__ATOMIC_SEQ_CST)
+	return __atomic_load_n(&x, __ATOMIC_SEQ_CST);
+#else
+	const u32 v = x;
+	pool_fence();
+	return v;
+#endif
+}
+
+static CAT_INLINE void pool_store(volatile u32 &x, const u32 v) {
+#if defined(__ATOMIC_SEQ_CST)
+	__atomic_store_n(&x, v, __ATOMIC_SEQ_CST);
+#else
+	pool_fence();
+	x = v;
+	pool_fence();
+#endif
+}
+
+// Later loads and stores are not moved before the load
+static CAT_INLINE u32 pool_load_acquire(volatile u32 &x) {
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n(&x, __ATOMIC_ACQUIRE);
+#else
+	return pool_load(x);
+#endif
+}
+
+// Earlier loads and stores are not moved after the store
+static CAT_INLINE void pool_store_release(volatile u32 &x, const u32 v) {
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n(&x, v, __ATOMIC_RELEASE);
+#else
+	pool_store(x, v);
+#endif
+}
+
+// Sets x = desired if x == expected.  Returns true if it did
+static CAT_INLINE bool pool_cas(volatile u32 &x, const u32 expected, const u32 desired) {
+#if defined(CAT_OS_WINDOWS)
+	return (u32)InterlockedCompareExchange((volatile LONG *)&x, (LONG)desired, (LONG)expected) == expected;
+#else
+	return __sync_bool_compare_and_swap(&x, expected, desired);
+#endif
+}
+
+// x += v.  Returns the new value
+static CAT_INLINE u32 pool_add(volatile u32 &x, const u32 v) {
+#if defined(CAT_OS_WINDOWS)
+	return (u32)InterlockedExchangeAdd((volatile LONG *)&x, (LONG)v) + v;
+#else
+	return __sync_add_and_fetch(&x, v);
+#endif
+}
+
+// x += v for a 64-bit counter
+static CAT_INLINE void pool_add64(volatile u64 &x, const u64 v) {
+#if defined(CAT_OS_WINDOWS)
+	InterlockedExchangeAdd64((volatile LONGLONG *)&x, (LONGLONG)v);
+#else
+	__sync_fetch_and_add(&x, v);
+#endif
+}
+
+static CAT_INLINE u64 pool_load64(volatile u64 &x) {
+#if defined(__ATOMIC_SEQ_CST)
+	return __atomic_load_n(&x, __ATOMIC_SEQ_CST);
+#elif defined(CAT_OS_WINDOWS)
+	return (u64)InterlockedCompareExchange64((volatile LONGLONG *)&x, 0, 0);
+#else
+	return __sync_fetch_and_add(&x, 0);
+#endif
+}
+
+// Hint to the processor that this is a spin loop
+static CAT_INLINE void pool_pause() {
+#if defined(CAT_OS_WINDOWS)
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#endif
+}
+
+// Chunks [begin, end) of the current job not yet taken
+struct pool_share {
+	pool_mutex lock;
+	int begin, end;
+	u8 pad[64]; // Keep shares off each other's cache lines
+};
+
+// Items [begin, end) of a batch.  Returns non-zero if any of them failed
+typedef int (*pool_job)(void *context, int begin, int end);
+
+// snowshoe_simul_parallel() handoff states
+enum {
+	HANDOFF_IDLE, // Free to claim
+	HANDOFF_CLAIMED, // A caller owns the slot
+	HANDOFF_POSTED, // Waiting for worker 1
+	HANDOFF_RUNNING, // Worker 1 is running it
+	HANDOFF_DONE // Result ready for the caller
+};
+
+// Spins of worker 1 on the handoff slot before it sleeps, about a millisecond.
+// On a single processor spinning only delays the caller, so it is skipped
+static const int POOL_HANDOFF_SPINS = 1 << 14;
+
+struct pool_worker;
+
+struct pool_state {
+	pool_mutex lock; // Protects the fields up to threads
+	pool_cond wake; // Workers wait here for a job
+	pool_cond done; // The caller waits here for the last chunk
+	volatile u32 generation; // Incremented for each job
+	int chunks_left;
+	int failed_chunks;
+	bool quit;
+
+	int threads; // Including the calling thread
+	int started; // Worker threads running
+	pool_mutex submit; // Held by the caller for the whole job
+
+	pool_job job;
+	void *context;
+	int items;
+	int chunk_items;
+
+	pool_share *shares; // One per thread, the caller is 0
+	pool_worker *workers; // Workers 1..threads-1
+	pool_thread *handles; // Workers 1..threads-1
+
+	// Handoff slot for snowshoe_simul_parallel(), on its own cache lines
+	u8 pad0[64];
+	volatile u32 handoff; // HANDOFF_* state
+	volatile u32 handoff_sleeping; // Worker 1 waits on handoff_wake
+	pool_cond handoff_wake; // Waited on with lock held
+	int handoff_spins; // POOL_HANDOFF_SPINS, or 0 on one processor
+	const char *handoff_k;
+	const char *handoff_P;
+	ecpt *handoff_H;
+	int handoff_failed;
+	u8 pad1[64];
+};
+
+struct pool_worker {
+	pool_state *pool;
+	int index;
+};
+
+// Takes the next chunk from this thread's share, or steals half of another share
+static bool pool_take(pool_state *pool, const int self, int &chunk) {
+	pool_share &own = pool->shares[self];
+
+	pool_lock(own.lock);
+	if (own.begin < own.end) {
+		chunk = own.begin++;
+		pool_unlock(own.lock);
+		return true;
+	}
+	pool_unlock(own.lock);
+
+	for (int ii = 1; ii < pool->threads; ++ii) {
+		pool_share &victim = pool->shares[(self + ii) % pool->threads];
+
+		pool_lock(victim.lock);
+		const int left = victim.end - victim.begin;
+		if (left <= 0) {
+			pool_unlock(victim.lock);
+			continue;
+		}
+		const int end = victim.end;
+		victim.end -= (left + 1) / 2;
+		const int begin = victim.end;
+		pool_unlock(victim.lock);
+
+		// Run the first stolen chunk and keep the rest
+		chunk = begin;
+		pool_lock(own.lock);
+		own.begin = begin + 1;
+		own.end = end;
+		pool_unlock(own.lock);
+		return true;
+	}
+
+	return false;
+}
+
+static void pool_work(pool_state *pool, const int self) {
+	int chunk;
+
+	// The job fields were written before the shares were filled, under their locks
+	while (pool_take(pool, self, chunk)) {
+		const int begin = chunk * pool->chunk_items;
+		const int end = (pool->items - begin < pool->chunk_items) ? pool->items : begin + pool->chunk_items;
+
+		const int failed = pool->job(pool->context, begin, end);
+
+		pool_lock(pool->lock);
+		if (failed) {
+			pool->failed_chunks++;
+		}
+		if (--pool->chunks_left == 0) {
+			pool_wake_all(pool->done);
+		}
+		pool_unlock(pool->lock);
+	}
+}
+
+// Runs a posted simul half.  Returns false if there was none
+static bool pool_handoff_take(pool_state *pool) {
+	if (pool_load(pool->handoff) != HANDOFF_POSTED ||
+		!pool_cas(pool->handoff, HANDOFF_POSTED, HANDOFF_RUNNING)) {
+		return false;
+	}
+
+	pool->handoff_failed = snowshoe_simul_half(pool->handoff_k, pool->handoff_P, (char *)pool->handoff_H);
+
+	pool_store(pool->handoff, HANDOFF_DONE);
+	return true;
+}
+
+// Worker 1 serves the handoff slot while no batch is running.  Called and returns with the lock held
+static void pool_handoff_serve(pool_state *pool, const u32 seen) {
+	while (!pool->quit && pool->generation == seen) {
+		pool_unlock(pool->lock);
+
+		// Serve halves until a batch starts, spinning for more after each one
+		int spins = 0;
+		while (pool_load(pool->generation) == seen) {
+			if (pool_handoff_take(pool)) {
+				spins = 0;
+			} else if (++spins > pool->handoff_spins) {
+				break;
+			} else {
+				pool_pause();
+			}
+		}
+
+		pool_lock(pool->lock);
+		if (pool->quit || pool->generation != seen) {
+			break;
+		}
+
+		// Callers check handoff_sleeping after posting, so one side sees the other
+		pool_store(pool->handoff_sleeping, 1);
+		if (pool_load(pool->handoff) != HANDOFF_POSTED) {
+			pool_wait(pool->handoff_wake, pool->lock);
+		}
+		pool_store(pool->handoff_sleeping, 0);
+	}
+}
+
+static void pool_worker_loop(pool_worker *worker) {
+	pool_state *pool = worker->pool;
+	u32 seen = 0;
+
+	pool_lock(pool->lock);
+	for (;;) {
+		if (worker->index == 1) {
+			pool_handoff_serve(pool, seen);
+		}
+		while (!pool->quit && pool->generation == seen) {
+			pool_wait(pool->wake, pool->lock);
+		}
+		if (pool->quit) {
+			break;
+		}
+		seen = pool->generation;
+		pool_unlock(pool->lock);
+
+		pool_work(pool, worker->index);
+
+		pool_lock(pool->lock);
+	}
+	pool_unlock(pool->lock);
+}
+
+#if defined(CAT_OS_WINDOWS)
+static DWORD WINAPI pool_main(void *arg) {
+	pool_worker_loop((pool_worker *)arg);
+	return 0;
+}
+#else
+static void *pool_main(void *arg) {
+	pool_worker_loop((pool_worker *)arg);
+	return 0;
+}
+#endif
+
+static void pool_free(pool_state *pool) {
+	delete []pool->handles;
+	delete []pool->workers;
+	delete []pool->shares;
+	delete pool;
+}
+
+static void pool_destroy(pool_state *pool) {
+	pool_lock(pool->lock);
+	pool->quit = true;
+	pool_wake_all(pool->wake);
+	pool_wake_one(pool->handoff_wake);
+	pool_unlock(pool->lock);
+
+	for (int ii = 1; ii <= pool->started; ++ii) {
+		pool_thread_join(pool->handles[ii]);
+	}
+
+	for (int ii = 0; ii < pool->threads; ++ii) {
+		pool_mutex_destroy(pool->shares[ii].lock);
+	}
+	pool_cond_destroy(pool->handoff_wake);
+	pool_cond_destroy(pool->done);
+	pool_cond_destroy(pool->wake);
+	pool_mutex_destroy(pool->submit);
+	pool_mutex_destroy(pool->lock);
+
+	pool_free(pool);
+}
+
+static pool_state *pool_create(int threads, const int *cpus) {
+	const int cpu_count = pool_cpu_count();
+	if (threads <= 0) {
+		// The length of cpus is only known from threads
+		if (cpus) {
+			return 0;
+		}
+		threads = cpu_count;
+	}
+	if (threads > POOL_MAX_THREADS) {
+		return 0;
+	}
+
+	pool_state *pool = new (std::nothrow) pool_state;
+	if (!pool) {
+		return 0;
+	}
+
+	pool->generation = 0;
+	pool->chunks_left = 0;
+	pool->failed_chunks = 0;
+	pool->quit = false;
+	pool->threads = threads;
+	pool->started = 0;
+	pool->job = 0;
+	pool->context = 0;
+	pool->items = 0;
+	pool->chunk_items = 0;
+	pool->handoff = HANDOFF_IDLE;
+	pool->handoff_sleeping = 0;
+	pool->handoff_spins = (cpu_count > 1) ? POOL_HANDOFF_SPINS : 0;
+	pool->handoff_k = 0;
+	pool->handoff_P = 0;
+	pool->handoff_H = 0;
+	pool->handoff_failed = 0;
+	pool->shares = new (std::nothrow) pool_share[threads];
+	pool->workers = new (std::nothrow) pool_worker[threads];
+	pool->handles = new (std::nothrow) pool_thread[threads];
+
+	if (!pool->shares || !pool->workers || !pool->handles) {
+		pool_free(pool);
+		return 0;
+	}
+
+	pool_mutex_init(pool->lock);
+	pool_mutex_init(pool->submit);
+	pool_cond_init(pool->wake);
+	pool_cond_init(pool->done);
+	pool_cond_init(pool->handoff_wake);
+	for (int ii = 0; ii < threads; ++ii) {
+		pool_mutex_init(pool->shares[ii].lock);
+		pool->shares[ii].begin = 0;
+		pool->shares[ii].end = 0;
+	}
+
+	bool ok = true;
+
+	for (int ii = 1; ii < threads; ++ii) {
+		pool_worker &worker = pool->workers[ii];
+		worker.pool = pool;
+		worker.index = ii;
+
+		ok = pool_thread_start(pool->handles[ii], pool_main, &worker);
+		if (!ok) {
+			break;
+		}
+		pool->started = ii;
+
+		if (cpus) {
+			ok = pool_set_affinity(pool->handles[ii], cpus[ii - 1]);
+		}
+	}
+
+	if (!ok) {
+		pool_destroy(pool);
+		return 0;
+	}
+
+	return pool;
+}
+
+// Runs job over items [0, n) in chunks of chunk_items on the pool, or on the calling thread with no pool.
+// Returns the number of chunks that failed
+static int pool_run(pool_state *pool, pool_job job, void *context, const int n, const int chunk_items) {
+	if (!pool || pool->threads <= 1 || n <= chunk_items) {
+		return job(context, 0, n) ? 1 : 0;
+	}
+
+	const int chunks = (n + chunk_items - 1) / chunk_items;
+
+	pool_lock(pool->submit);
+
+	pool->job = job;
+	pool->context = context;
+	pool->items = n;
+	pool->chunk_items = chunk_items;
+
+	pool_lock(pool->lock);
+	pool->chunks_left = chunks;
+	pool->failed_chunks = 0;
+	pool_unlock(pool->lock);
+
+	// Deal out even shares
+	for (int ii = 0; ii < pool->threads; ++ii) {
+		pool_share &share = pool->shares[ii];
+		pool_lock(share.lock);
+		share.begin = (int)((s64)chunks * ii / pool->threads);
+		share.end = (int)((s64)chunks * (ii + 1) / pool->threads);
+		pool_unlock(share.lock);
+	}
+
+	// Worker 1 may be spinning on the generation without the lock
+	pool_lock(pool->lock);
+	pool_add(pool->generation, 1);
+	pool_wake_all(pool->wake);
+	pool_wake_one(pool->handoff_wake);
+	pool_unlock(pool->lock);
+
+	// Work on the batch too, then wait for chunks still running elsewhere
+	pool_work(pool, 0);
+
+	pool_lock(pool->lock);
+	while (pool->chunks_left > 0) {
+		pool_wait(pool->done, pool->lock);
+	}
+	const int failed = pool->failed_chunks;
+	pool_unlock(pool->lock);
+
+	pool_unlock(pool->submit);
+
+	return failed;
+}
+
+struct keygen_batch_job {
+	const char (*seeds)[32];
+	char (*k)[32];
+	char (*P)[64];
+};
+
+static int keygen_batch_chunk(void *context, int begin, int end) {
+	const keygen_batch_job *job = (const keygen_batch_job *)context;
+
+	return snowshoe_keygen_batch(job->seeds + begin, end - begin, job->k + begin, job->P + begin);
+}
+
+struct mul_batch_job {
+	const char (*k)[32];
+	const char (*P)[64];
+	char (*R)[64];
+	int *status;
+};
+
+static int mul_batch_chunk(void *context, int begin, int end) {
+	const mul_batch_job *job = (const mul_batch_job *)context;
+
+	return snowshoe_mul_batch(job->k + begin, job->P + begin, end - begin, job->R + begin, job->status + begin);
+}
+
+struct verify_batch_job {
+	const char (*pk)[64];
+	const snowshoe_iovec *msg;
+	const char (*sig)[96];
+	int *status;
+};
+
+static int verify_batch_chunk(void *context, int begin, int end) {
+	const verify_batch_job *job = (const verify_batch_job *)context;
+	int failed = 0;
+
+	for (int ii = begin; ii < end; ++ii) {
+		job->status[ii] = verify_iov(job->pk[ii], &job->msg[ii], 1, 0, job->sig[ii]) ? -1 : 0;
+		failed |= job->status[ii];
+	}
+
+	return failed;
+}
+
+//// Job Queue
+
+/*
+ * Asynchronous jobs for event-loop servers
+ *
+ * The event loop submits jobs without blocking and collects them later
+ * with snowshoe_poll().  Worker threads take a share of the waiting jobs,
+ * up to QUEUE_BATCH at a time, and run the MUL jobs among them with
+ * snowshoe_mul_batch() so that they share an inversion.  So the busier the
+ * queue, the more the work is batched.
+ *
+ * Submitted jobs go through a lock-free ring of job pointers [DV], and
+ * finished jobs come back through a second one, so producers, workers and
+ * the event loop never wait on each other.  Each cell has a sequence
+ * number that says whether it is free to push or ready to pop at the
+ * current lap, and the head and tail are claimed with CAS.  The rings are
+ * sized to a power of two of at least capacity, and in_flight limits the
+ * jobs to capacity, so a push never finds the ring full.
+ *
+ * Workers only take the lock to sleep when there is nothing to do.  They
+ * count themselves in sleepers first, and snowshoe_submit() only takes the
+ * lock to wake one if sleepers is non-zero after its push.
+ *
+ * A file descriptor becomes readable when done_count goes from zero to
+ * non-zero, and is reset by snowshoe_poll() once it is zero again.  It is
+ * an eventfd on Linux and a pipe on other POSIX systems.
+ *
+ * [DV] "Bounded MPMC queue" (Vyukov)
+ *      http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+
+static const int QUEUE_BATCH = EC_MUL_MANY_CHUNK;
+static const int QUEUE_MAX_THREADS = 256;
+static const int QUEUE_MAX_CAPACITY = 1 << 20;
+
+struct queue_cell {
+	volatile u32 seq; // Position + 1 when ready to pop, position + size when free
+	snowshoe_job *job;
+};
+
+// Lock-free ring of job pointers, with head and tail on their own cache lines
+struct queue_ring {
+	queue_cell *cells;
+	u32 mask; // Size - 1
+	u8 pad0[64];
+	volatile u32 tail; // Next position to push
+	u8 pad1[64];
+	volatile u32 head; // Next position to pop
+	u8 pad2[64];
+};
+
+static void queue_ring_init(queue_ring &ring, const u32 size) {
+	for (u32 ii = 0; ii < size; ++ii) {
+		ring.cells[ii].seq = ii;
+		ring.cells[ii].job = 0;
+	}
+	ring.mask = size - 1;
+	ring.tail = 0;
+	ring.head = 0;
+}
+
+// Returns false if the ring is full
+static bool queue_push(queue_ring &ring, snowshoe_job *job) {
+	u32 pos = pool_load_acquire(ring.tail);
+
+	for (;;) {
+		queue_cell &cell = ring.cells[pos & ring.mask];
+		const s32 lag = (s32)(pool_load_acquire(cell.seq) - pos);
+
+		if (lag == 0) {
+			if (pool_cas(ring.tail, pos, pos + 1)) {
+				cell.job = job;
+				pool_store_release(cell.seq, pos + 1);
+				return true;
+			}
+		} else if (lag < 0) {
+			return false;
+		}
+
+		pos = pool_load_acquire(ring.tail);
+	}
+}
+
+// Returns null if the ring is empty
+static snowshoe_job *queue_pop(queue_ring &ring) {
+	u32 pos = pool_load_acquire(ring.head);
+
+	for (;;) {
+		queue_cell &cell = ring.cells[pos & ring.mask];
+		const s32 lag = (s32)(pool_load_acquire(cell.seq) - (pos + 1));
+
+		if (lag == 0) {
+			if (pool_cas(ring.head, pos, pos + 1)) {
+				snowshoe_job *job = cell.job;
+				pool_store_release(cell.seq, pos + ring.mask + 1);
+				return job;
+			}
+		} else if (lag < 0) {
+			return 0;
+		}
+
+		pos = pool_load_acquire(ring.head);
+	}
+}
+
+// Jobs pushed and not yet popped, which may be briefly off by the pushes in progress
+static CAT_INLINE int queue_size(queue_ring &ring) {
+	return (int)(pool_load(ring.tail) - pool_load(ring.head));
+}
+
+struct queue_state {
+	queue_ring pending, done;
+	volatile u32 in_flight; // Submitted and not yet returned by snowshoe_poll()
+	volatile u32 done_count; // Counted before the push to done
+	volatile u32 sleepers; // Workers that are waiting on wake or about to
+	u8 pad[64];
+
+	pool_mutex lock; // Held to sleep, wake and quit
+	pool_cond wake; // Workers wait here for jobs
+	bool quit;
+
+	int capacity;
+	int threads, started;
+	int fds[2]; // Read and write ends of the notification, or -1
+	pool_thread *handles;
+};
+
+static bool queue_signal_init(queue_state *q) {
+	q->fds[0] = q->fds[1] = -1;
+
+#if defined(CAT_OS_WINDOWS)
+	return true;
+#elif defined(__linux__)
+	q->fds[0] = q->fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return q->fds[0] >= 0;
+#else
+	if (pipe(q->fds) != 0) {
+		q->fds[0] = q->fds[1] = -1;
+		return false;
+	}
+	for (int ii = 0; ii < 2; ++ii) {
+		fcntl(q->fds[ii], F_SETFL, fcntl(q->fds[ii], F_GETFL) | O_NONBLOCK);
+		fcntl(q->fds[ii], F_SETFD, FD_CLOEXEC);
+	}
+	return true;
+#endif
+}
+
+static void queue_signal_close(queue_state *q) {
+#if !defined(CAT_OS_WINDOWS)
+	if (q->fds[0] >= 0) {
+		close(q->fds[0]);
+	}
+	if (q->fds[1] >= 0 && q->fds[1] != q->fds[0]) {
+		close(q->fds[1]);
+	}
+#else
+	(void)q;
+#endif
+}
+
+static void queue_signal_set(queue_state *q) {
+#if !defined(CAT_OS_WINDOWS)
+	const u64 one = 1;
+	const ssize_t written = write(q->fds[1], &one, q->fds[0] == q->fds[1] ? 8 : 1);
+	(void)written;
+#else
+	(void)q;
+#endif
+}
+
+static void queue_signal_clear(queue_state *q) {
+#if !defined(CAT_OS_WINDOWS)
+	u64 drain[8];
+	while (read(q->fds[0], drain, sizeof(drain)) > 0) {
+	}
+#else
+	(void)q;
+#endif
+}
+
+static void queue_run(snowshoe_job *jobs[], const int n) {
+	char k[QUEUE_BATCH][32], P[QUEUE_BATCH][64], R[QUEUE_BATCH][64];
+	int status[QUEUE_BATCH];
+	snowshoe_job *muls[QUEUE_BATCH];
+	int count = 0;
+
+	for (int ii = 0; ii < n; ++ii) {
+		snowshoe_job *job = jobs[ii];
+
+		switch (job->op) {
+		case SNOWSHOE_OP_MUL_GEN:
+			job->result = snowshoe_mul_gen(job->a, job->R, 0);
+			break;
+		case SNOWSHOE_OP_MUL:
+			memcpy(k[count], job->a, 32);
+			memcpy(P[count], job->P, 64);
+			muls[count++] = job;
+			break;
+		case SNOWSHOE_OP_SIMUL:
+			job->result = snowshoe_simul(job->a, job->P, job->b, job->Q, job->R);
+			break;
+		default:
+			job->result = -1;
+			break;
+		}
+	}
+
+	if (count > 0) {
+		snowshoe_mul_batch(k, P, count, R, status);
+
+		for (int ii = 0; ii < count; ++ii) {
+			muls[ii]->result = status[ii];
+			memcpy(muls[ii]->R, R[ii], 64);
+		}
+
+		CAT_SECURE_OBJCLR(k);
+		CAT_SECURE_OBJCLR(R);
+	}
+}
+
+static void queue_worker_loop(queue_state *q) {
+	snowshoe_job *jobs[QUEUE_BATCH];
+
+	for (;;) {
+		// Take a fair share, so a short queue is still spread over the threads
+		int take = queue_size(q->pending) / q->threads;
+		if (take < 1) {
+			take = 1;
+		} else if (take > QUEUE_BATCH) {
+			take = QUEUE_BATCH;
+		}
+
+		int n = 0;
+		while (n < take && (jobs[n] = queue_pop(q->pending)) != 0) {
+			++n;
+		}
+
+		if (n == 0) {
+			// Count this thread as a sleeper before checking again, since
+			// snowshoe_submit() checks sleepers after its push
+			pool_lock(q->lock);
+			pool_add(q->sleepers, 1);
+			while (!q->quit && queue_size(q->pending) <= 0) {
+				pool_wait(q->wake, q->lock);
+			}
+			pool_add(q->sleepers, (u32)-1);
+
+			// Finish the pending jobs before quitting
+			const bool quit = q->quit && queue_size(q->pending) <= 0;
+			pool_unlock(q->lock);
+
+			if (quit) {
+				break;
+			}
+			continue;
+		}
+
+		queue_run(jobs, n);
+
+		// Count before pushing, so done_count never trails the ring
+		const bool was_empty = pool_add(q->done_count, n) == (u32)n;
+		for (int ii = 0; ii < n; ++ii) {
+			queue_push(q->done, jobs[ii]);
+		}
+		if (was_empty) {
+			queue_signal_set(q);
+		}
+	}
+}
+
+#if defined(CAT_OS_WINDOWS)
+static DWORD WINAPI queue_main(void *arg) {
+	queue_worker_loop((queue_state *)arg);
+	return 0;
+}
+#else
+static void *queue_main(void *arg) {
+	queue_worker_loop((queue_state *)arg);
+	return 0;
+}
+#endif
+
+static void queue_free(queue_state *q) {
+	delete []q->handles;
+	delete []q->done.cells;
+	delete []q->pending.cells;
+	delete q;
+}
+
+static void queue_destroy(queue_state *q) {
+	pool_lock(q->lock);
+	q->quit = true;
+	pool_wake_all(q->wake);
+	pool_unlock(q->lock);
+
+	for (int ii = 0; ii < q->started; ++ii) {
+		pool_thread_join(q->handles[ii]);
+	}
+
+	queue_signal_close(q);
+	pool_cond_destroy(q->wake);
+	pool_mutex_destroy(q->lock);
+
+	queue_free(q);
+}
+
+static queue_state *queue_create(int threads, const int capacity) {
+	if (threads <= 0) {
+		threads = pool_cpu_count();
+	}
+	if (threads > QUEUE_MAX_THREADS || capacity <= 0 || capacity > QUEUE_MAX_CAPACITY) {
+		return 0;
+	}
+
+	queue_state *q = new (std::nothrow) queue_state;
+	if (!q) {
+		return 0;
+	}
+
+	// Ring size is a power of two, so positions can wrap around 2^32
+	u32 size = 1;
+	while (size < (u32)capacity) {
+		size <<= 1;
+	}
+
+	q->in_flight = 0;
+	q->done_count = 0;
+	q->sleepers = 0;
+	q->quit = false;
+	q->capacity = capacity;
+	q->threads = threads;
+	q->started = 0;
+	q->fds[0] = q->fds[1] = -1;
+	q->pending.cells = new (std::nothrow) queue_cell[size];
+	q->done.cells = new (std::nothrow) queue_cell[size];
+	q->handles = new (std::nothrow) pool_thread[threads];
+
+	if (!q->pending.cells || !q->done.cells || !q->handles) {
+		queue_free(q);
+		return 0;
+	}
+
+	queue_ring_init(q->pending, size);
+	queue_ring_init(q->done, size);
+
+	pool_mutex_init(q->lock);
+	pool_cond_init(q->wake);
+
+	bool ok = queue_signal_init(q);
+
+	for (int ii = 0; ii < threads && ok; ++ii) {
+		ok = pool_thread_start(q->handles[ii], queue_main, q);
+		if (ok) {
+			q->started = ii + 1;
+		}
+	}
+
+	if (!ok) {
+		queue_destroy(q);
+		return 0;
+	}
+
+	return q;
+}
+
+
+//// Ephemeral Key Pool
+
+/*
+ * Precomputed ephemeral key pairs
+ *
+ * A handshake that starts with a fresh key pair pays for snowshoe_mul_gen()
+ * before it can send anything.  The pool keeps a ring of ready (k, kG)
+ * pairs so that taking one is a copy.  One background thread sleeps until
+ * the ring falls to the low-water mark and then refills it to capacity
+ * with snowshoe_keygen_batch(), EPHEMERAL_BATCH keys at a time so they
+ * share an inversion.
+ *
+ * The ring works like the job queue rings [DV], with the pair stored in
+ * the cell: A pop claims a cell by CAS on head, copies the pair out,
+ * erases it and releases the cell to the next lap.  There is only one
+ * producer, so it pushes without a CAS.  Pops never take the lock.  The
+ * producer takes it to sleep, after setting sleeping, and a pop only takes
+ * it to wake the producer if sleeping is set and the ring is at the
+ * low-water mark.  If the ring is empty, the caller generates its own pair
+ * rather than waiting for the producer.
+ *
+ * Popping a full pool in a loop on one CPU, the locked stack took 100 ns
+ * a pop from one thread and 117 ns from four, and the ring takes 45 ns and
+ * 51 ns.  The locked stack also stalled every pop for as long as the lock
+ * holder was descheduled, which the ring never does.
+ */
+
+static const int EPHEMERAL_BATCH = EC_MUL_MANY_CHUNK;
+static const int EPHEMERAL_MAX_CAPACITY = 1 << 16;
+
+struct ephemeral_cell {
+	volatile u32 seq; // Position + 1 when ready to pop, position + size when free
+	char k[32];
+	char P[64];
+};
+
+struct ephemeral_state {
+	ephemeral_cell *cells;
+	u32 mask; // Size - 1
+	u8 pad0[64];
+	volatile u32 tail; // Next position to push, only written by the producer
+	u8 pad1[64];
+	volatile u32 head; // Next position to pop
+	u8 pad2[64];
+	volatile u64 hits, misses;
+	volatile u32 sleeping; // Producer is waiting on wake or about to
+	volatile u32 quit;
+	u8 pad3[64];
+
+	pool_mutex lock; // Held to sleep, wake and quit
+	pool_cond wake; // Producer waits here for the low-water mark
+
+	int capacity, low_water;
+	snowshoe_random rng;
+	void *rng_context;
+	bool started;
+	pool_thread handle;
+};
+
+// Pairs pushed and not yet popped, which may be briefly off by the pops in progress
+static CAT_INLINE int ephemeral_size(ephemeral_state *e) {
+	return (int)(pool_load(e->tail) - pool_load(e->head));
+}
+
+// Only called by the producer, and only when the ring is below capacity
+static void ephemeral_push(ephemeral_state *e, const char k[32], const char P[64]) {
+	const u32 pos = pool_load(e->tail);
+	ephemeral_cell &cell = e->cells[pos & e->mask];
+
+	// A pop that claimed this cell a lap ago may not have released it yet
+	while (pool_load_acquire(cell.seq) != pos) {
+		pool_pause();
+	}
+
+	memcpy(cell.k, k, 32);
+	memcpy(cell.P, P, 64);
+	pool_store_release(cell.seq, pos + 1);
+	pool_store(e->tail, pos + 1);
+}
+
+static void ephemeral_worker_loop(ephemeral_state *e) {
+	char seeds[EPHEMERAL_BATCH][32];
+	char P[EPHEMERAL_BATCH][64];
+
+	for (;;) {
+		// Pops read sleeping after they move head, and this reads head after
+		// setting it, so one of them sees the other
+		pool_lock(e->lock);
+		pool_store(e->sleeping, 1);
+		while (!pool_load(e->quit) && ephemeral_size(e) > e->low_water) {
+			pool_wait(e->wake, e->lock);
+		}
+		pool_store(e->sleeping, 0);
+		pool_unlock(e->lock);
+
+		if (pool_load(e->quit)) {
+			break;
+		}
+
+		// Refill to capacity.  Only pops happen meanwhile, so the space
+		// counted before generating is still free afterwards.
+		bool ok = true;
+		while (ok && !pool_load(e->quit)) {
+			int n = e->capacity - ephemeral_size(e);
+			if (n <= 0) {
+				break;
+			}
+			if (n > EPHEMERAL_BATCH) {
+				n = EPHEMERAL_BATCH;
+			}
+
+			// k may be the same array as seeds
+			ok = e->rng(e->rng_context, seeds[0], n * 32) == 0 &&
+				 snowshoe_keygen_batch(seeds, n, seeds, P) == 0;
+
+			for (int ii = 0; ok && ii < n; ++ii) {
+				ephemeral_push(e, seeds[ii], P[ii]);
+			}
+		}
+
+		CAT_SECURE_OBJCLR(seeds);
+
+		// If the random source failed, stop: Callers generate their own
+		// pairs from now on and get the error from it themselves
+		if (!ok) {
+			break;
+		}
+	}
+}
+
+#if defined(CAT_OS_WINDOWS)
+static DWORD WINAPI ephemeral_main(void *arg) {
+	ephemeral_worker_loop((ephemeral_state *)arg);
+	return 0;
+}
+#else
+static void *ephemeral_main(void *arg) {
+	ephemeral_worker_loop((ephemeral_state *)arg);
+	return 0;
+}
+#endif
+
+static void ephemeral_destroy(ephemeral_state *e) {
+	pool_lock(e->lock);
+	pool_store(e->quit, 1);
+	pool_wake_all(e->wake);
+	pool_unlock(e->lock);
+
+	if (e->started) {
+		pool_thread_join(e->handle);
+	}
+
+	pool_cond_destroy(e->wake);
+	pool_mutex_destroy(e->lock);
+
+	CAT_SECURE_CLR(e->cells, (e->mask + 1) * sizeof(ephemeral_cell));
+	delete []e->cells;
+	delete e;
+}
+
+static ephemeral_state *ephemeral_create(const int capacity, const int low_water, snowshoe_random rng, void *rng_context) {
+	if (capacity <= 0 || capacity > EPHEMERAL_MAX_CAPACITY ||
+		low_water < 0 || low_water >= capacity || !rng) {
+		return 0;
+	}
+
+	ephemeral_state *e = new (std::nothrow) ephemeral_state;
+	if (!e) {
+		return 0;
+	}
+
+	u32 size = 1;
+	while (size < (u32)capacity) {
+		size <<= 1;
+	}
+
+	e->cells = new (std::nothrow) ephemeral_cell[size];
+	if (!e->cells) {
+		delete e;
+		return 0;
+	}
+
+	for (u32 ii = 0; ii < size; ++ii) {
+		e->cells[ii].seq = ii;
+	}
+	e->mask = size - 1;
+	e->tail = 0;
+	e->head = 0;
+	e->hits = 0;
+	e->misses = 0;
+	e->sleeping = 0;
+	e->quit = 0;
+	e->capacity = capacity;
+	e->low_water = low_water;
+	e->rng = rng;
+	e->rng_context = rng_context;
+	e->started = false;
+
+	pool_mutex_init(e->lock);
+	pool_cond_init(e->wake);
+
+	// The producer starts below the low-water mark, so it fills right away
+	e->started = pool_thread_start(e->handle, ephemeral_main, e);
+	if (!e->started) {
+		ephemeral_destroy(e);
+		return 0;
+	}
+
+	return e;
+}
+
+// Returns false if the ring is empty
+static bool ephemeral_take(ephemeral_state *e, char k[32], char P[64]) {
+	u32 pos = pool_load_acquire(e->head);
+	ephemeral_cell *cell;
+
+	for (;;) {
+		cell = &e->cells[pos & e->mask];
+		const s32 lag = (s32)(pool_load_acquire(cell->seq) - (pos + 1));
+
+		if (lag == 0) {
+			if (pool_cas(e->head, pos, pos + 1)) {
+				break;
+			}
+		} else if (lag < 0) {
+			pool_add64(e->misses, 1);
+			return false;
+		}
+
+		pos = pool_load_acquire(e->head);
+	}
+
+	memcpy(k, cell->k, 32);
+	memcpy(P, cell->P, 64);
+	CAT_SECURE_CLR(cell->k, 32);
+	pool_store_release(cell->seq, pos + e->mask + 1);
+	pool_add64(e->hits, 1);
+
+	// The producer only sleeps above the low-water mark, so wake it on the way down
+	if (pool_load(e->sleeping) && ephemeral_size(e) <= e->low_water) {
+		pool_lock(e->lock);
+		pool_wake_one(e->wake);
+		pool_unlock(e->lock);
+	}
+
+	return true;
+}
+//// Point Cache
+
+/*
+ * Cache of peer point tables
+ *
+ * Servers often multiply by the same peer public keys again and again.
+ * The cache keeps the ec_point_table of recently used points, keyed by
+ * their 64-byte serialized form, so a hit skips validation and the
+ * endomorphism and table setup.  It also keeps the point and its
+ * endomorphism for ec_simul, whose ec_gen_table_4 mixes both points and
+ * so is rebuilt on every call.  Only valid points are inserted.
+ *
+ * The cache is set-associative with CACHE_WAYS ways per set, and evicts a
+ * way with the CLOCK policy: A hit sets the way's used flag, and the
+ * writer's hand clears used flags until it finds a way without one.  A hit
+ * only writes that flag if it was clear and the hit counter of its set,
+ * so threads that hit points in different sets do not share cache lines.
+ *
+ * Lookups take no lock.  Each way has a sequence number that a writer
+ * makes odd while it rewrites the way and even again after, as in a
+ * seqlock [SL].  A reader copies the key and the parts it needs out of
+ * the way, and only uses the copy if the sequence number was the same
+ * even value before and after.  The words are copied with relaxed atomic
+ * loads, so a reader that races with a writer just gets a copy it throws
+ * away.  Writers are rare, since they only run after a miss has validated
+ * a new point, and they take a spinlock per set.
+ *
+ * Lookups are variable-time, which is fine since the points are public.
+ *
+ * [SL] "Can Seqlocks Get Along With Programming Language Memory Models?"
+ *      (Boehm 2012)
+ */
+
+static const int CACHE_WAYS = 4;
+static const int CACHE_MAX_SETS = 16384;
+
+// Parts of a way that are copied out on a hit
+struct cache_payload {
+	ecpt_affine point; // Deserialized point
+	ecpt_affine morph; // Endomorphism of point
+	ec_point_table table;
+};
+
+// Bytes of the payload that ec_simul needs
+static const int CACHE_POINTS_BYTES = 2 * sizeof(ecpt_affine);
+
+struct cache_way {
+	volatile u32 seq; // 0 if empty, odd while being written
+	volatile u32 used; // Set by hits, cleared by the eviction hand
+	u32 pad[14];
+	u64 key[8]; // Serialized point
+	cache_payload data;
+};
+
+struct cache_set {
+	volatile u32 lock; // Held by a writer
+	u32 hand; // Next way the writer considers evicting
+	volatile u64 hits, misses;
+	u64 pad[5];
+	cache_way way[CACHE_WAYS];
+};
+
+struct cache_header {
+	u64 sets; // Number of sets, a power of two
+	u64 pad[7];
+};
+
+// Copies words that a writer may be changing
+static CAT_INLINE void cache_read_words(const u64 *src, u64 *dst, const int words) {
+	for (int ii = 0; ii < words; ++ii) {
+#if defined(__ATOMIC_RELAXED)
+		dst[ii] = __atomic_load_n(src + ii, __ATOMIC_RELAXED);
+#else
+		dst[ii] = ((const volatile u64 *)src)[ii];
+#endif
+	}
+}
+
+// Copies words that readers may be reading
+static CAT_INLINE void cache_write_words(const u64 *src, u64 *dst, const int words) {
+	for (int ii = 0; ii < words; ++ii) {
+#if defined(__ATOMIC_RELAXED)
+		__atomic_store_n(dst + ii, src[ii], __ATOMIC_RELAXED);
+#else
+		((volatile u64 *)dst)[ii] = src[ii];
+#endif
+	}
+}
+
+static CAT_INLINE cache_set *cache_find_set(cache_header *cache, const u64 key[8]) {
+	return (cache_set *)(cache + 1) + (ec_point_hash(key) & (cache->sets - 1));
+}
+
+// Returns the number of sets needed to hold at least the given number of entries
+static int cache_sets(const int entries) {
+	int sets = 1;
+	while (sets * CACHE_WAYS < entries) {
+		sets <<= 1;
+	}
+	return sets;
+}
+
+static CAT_INLINE int cache_bytes(const int sets) {
+	return (int)sizeof(cache_header) + sets * (int)sizeof(cache_set);
+}
+
+static void cache_init(const int sets, cache_header *cache) {
+	cache->sets = sets;
+
+	cache_set *set = (cache_set *)(cache + 1);
+	for (int ii = 0; ii < sets; ++ii) {
+		set[ii].lock = 0;
+		set[ii].hand = 0;
+		set[ii].hits = 0;
+		set[ii].misses = 0;
+
+		for (int jj = 0; jj < CACHE_WAYS; ++jj) {
+			set[ii].way[jj].seq = 0;
+			set[ii].way[jj].used = 0;
+		}
+	}
+}
+
+/*
+ * Look up key and copy out the first bytes of its payload.
+ *
+ * Returns true on a hit.  Returns false on a miss, and then the caller
+ * should validate the point and fill in the whole payload before calling
+ * cache_insert(), so that invalid points never evict an entry.
+ */
+static bool cache_lookup(cache_header *cache, const u64 key[8], const int bytes, cache_payload &out) {
+	cache_set &set = *cache_find_set(cache, key);
+
+	for (int ii = 0; ii < CACHE_WAYS; ++ii) {
+		cache_way &way = set.way[ii];
+
+		const u32 seq = pool_load_acquire(way.seq);
+		if (seq == 0 || (seq & 1) != 0) {
+			continue;
+		}
+
+		u64 found[8];
+		cache_read_words(way.key, found, 8);
+
+		u64 diff = 0;
+		for (int jj = 0; jj < 8; ++jj) {
+			diff |= found[jj] ^ key[jj];
+		}
+		if (diff != 0) {
+			continue;
+		}
+
+		cache_read_words((const u64 *)&way.data, (u64 *)&out, bytes / 8);
+
+		// If a writer started meanwhile, the copy may be torn
+		pool_fence();
+		if (pool_load(way.seq) != seq) {
+			continue;
+		}
+
+		if (!pool_load(way.used)) {
+			pool_store(way.used, 1);
+		}
+		pool_add64(set.hits, 1);
+		return true;
+	}
+
+	pool_add64(set.misses, 1);
+	return false;
+}
+
+// Add key with a payload filled in after a missed lookup
+static void cache_insert(cache_header *cache, const u64 key[8], const cache_payload &in) {
+	cache_set &set = *cache_find_set(cache, key);
+
+	while (!pool_cas(set.lock, 0, 1)) {
+		pool_pause();
+	}
+
+	// Another thread may have added it since the lookup
+	for (int ii = 0; ii < CACHE_WAYS; ++ii) {
+		cache_way &way = set.way[ii];
+
+		u64 found[8];
+		cache_read_words(way.key, found, 8);
+
+		u64 diff = 0;
+		for (int jj = 0; jj < 8; ++jj) {
+			diff |= found[jj] ^ key[jj];
+		}
+		if (diff == 0 && pool_load(way.seq) != 0) {
+			pool_store_release(set.lock, 0);
+			return;
+		}
+	}
+
+	// Evict the first way that was not used since the hand last passed it
+	cache_way *victim;
+	for (;;) {
+		victim = &set.way[set.hand];
+		set.hand = (set.hand + 1) % CACHE_WAYS;
+
+		if (pool_load(victim->seq) == 0 || !pool_load(victim->used)) {
+			break;
+		}
+		pool_store(victim->used, 0);
+	}
+
+	const u32 seq = pool_load(victim->seq);
+	pool_store(victim->seq, seq + 1);
+	pool_fence();
+
+	cache_write_words(key, victim->key, 8);
+	cache_write_words((const u64 *)&in, (u64 *)&victim->data, sizeof(cache_payload) / 8);
+	pool_store(victim->used, 1);
+
+	pool_store_release(victim->seq, seq + 2);
+	pool_store_release(set.lock, 0);
+}
+
+/*
+ * Copy out the payload for P, or validate P and add it on a miss.  Only
+ * the first bytes of the payload are set on a hit.
+ *
+ * Returns false if P is invalid.
+ */
+static bool cache_get(cache_header *cache, const char P[64], const int bytes, cache_payload &c) {
+	const u64 *key = (const u64 *)P;
+
+	if (cache_lookup(cache, key, bytes, c)) {
+		return true;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ec_load_xy((const u8*)P, c.point);
+
+	// Validate point
+	const bool valid = ec_valid(c.point);
+#else
+	c.point = *(const ecpt_affine *)P;
+
+	// Validate point
+	const bool valid = ec_valid_vartime(c.point);
+#endif // CAT_ENDIAN_LITTLE
+
+	// Leave the set alone if the point is invalid
+	if (!valid) {
+		return false;
+	}
+
+	gls_morph(c.point.x, c.point.y, c.morph.x, c.morph.y);
+	ec_gen_point_table(c.point, c.table);
+
+	cache_insert(cache, key, c);
+
+	return true;
+}
+
+// Cache used by snowshoe_mul(), snowshoe_simul() and snowshoe_mul_batch(), or null
+static cache_header *m_point_cache = 0;
+
+static int cache_mul(cache_header *cache, const char k_raw[32], const char P[64], char R[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+#else
+	const u64 *k = (const u64 *)k_raw;
+#endif // CAT_ENDIAN_LITTLE
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Find the table for P, keyed by its serialized form
+	cache_payload c;
+	if (!cache_get(cache, P, sizeof(cache_payload), c)) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Multiply
+	ecpt_affine r;
+	ec_mul_table_affine(k, c.table, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(r);
+#else
+	// Multiply
+	ec_mul_table_affine(k, c.table, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+static int cache_simul(cache_header *cache, const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k1[4], k2[4];
+	ec_load_k(a, k1);
+	ec_load_k(b, k2);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+#endif // CAT_ENDIAN_LITTLE
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Find the points and their endomorphisms
+	cache_payload p1, p2;
+	if (!cache_get(cache, P, CACHE_POINTS_BYTES, p1) ||
+		!cache_get(cache, Q, CACHE_POINTS_BYTES, p2)) {
+		return -1;
+	}
+
+	// Decompose scalars into subscalars
+	ec_decomp da, db;
+	gls_decompose(k1, da.asign, da.a, da.bsign, da.b);
+	gls_decompose(k2, db.asign, db.a, db.bsign, db.b);
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Multiply
+	ecpt_affine r;
+	ec_simul_morphed_affine(da, p1.point, p1.morph, db, p2.point, p2.morph, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k1);
+	CAT_SECURE_OBJCLR(k2);
+	CAT_SECURE_OBJCLR(r);
+#else
+	// Multiply
+	ec_simul_morphed_affine(da, p1.point, p1.morph, db, p2.point, p2.morph, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	CAT_SECURE_OBJCLR(da);
+	CAT_SECURE_OBJCLR(db);
+
+	return 0;
+}
+
+// Same as snowshoe_mul_batch(), with each product evaluated from its cached table
+static int cache_mul_batch(cache_header *cache, const char k_raw[][32], const char P[][64], int n, char R[][64], int status[]) {
+	u64 k[4];
+	ecpt X[EC_MUL_MANY_CHUNK];
+	ufe zs[EC_MUL_MANY_CHUNK];
+	ecpt_affine r[EC_MUL_MANY_CHUNK];
+	cache_payload c;
+	int failures = 0;
+
+	for (int offset = 0; offset < n; offset += EC_MUL_MANY_CHUNK) {
+		const int count = (n - offset < EC_MUL_MANY_CHUNK) ? n - offset : EC_MUL_MANY_CHUNK;
+
+		for (int ii = 0; ii < count; ++ii) {
+			const int jj = offset + ii;
+
+#ifndef CAT_ENDIAN_LITTLE
+			ec_load_k(k_raw[jj], k);
+#else
+			memcpy(k, k_raw[jj], 32);
+#endif // CAT_ENDIAN_LITTLE
+
+			const bool valid = !invalid_key(k) && cache_get(cache, P[jj], sizeof(cache_payload), c);
+
+			// Invalid entries get G so the shared inversion still works
+			if (valid) {
+				ec_mul_table(k, c.table, X[ii]);
+			} else {
+				ec_set(EC_G, X[ii]);
+				++failures;
+			}
+
+			status[jj] = valid ? 0 : -1;
+		}
+
+		// Compute affine coordinates
+		ec_affine_n(X, count, zs, r);
+
+		// Store results, with zeroes for invalid entries
+		for (int ii = 0; ii < count; ++ii) {
+			const int jj = offset + ii;
+
+			if (status[jj] != 0) {
+				memset(R[jj], 0, 64);
+				continue;
+			}
+
+#ifndef CAT_ENDIAN_LITTLE
+			ec_save_xy(r[ii], (u8*)R[jj]);
+#else
+			memcpy(R[jj], &r[ii], 64);
+#endif // CAT_ENDIAN_LITTLE
+		}
+	}
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(X);
+	CAT_SECURE_OBJCLR(zs);
+	CAT_SECURE_OBJCLR(r);
+
+	return failures ? -1 : 0;
+}
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int _snowshoe_init(int expected_version) {
+	// If math object is aligned oddly.
+	if (sizeof(ecpt_affine) != 64) {
+		return -1;
+	}
+
+	if (sizeof(ecpt) != 128) {
+		return -1;
+	}
+
+	if (sizeof(ufp) != 16) {
+		return -1;
+	}
+
+	if (sizeof(ec_point_table) != sizeof(snowshoe_point_table)) {
+		return -1;
+	}
+
+	if (sizeof(ec_keypair) != sizeof(snowshoe_keypair)) {
+		return -1;
+	}
+
+	if (sizeof(ecpt) != sizeof(snowshoe_point)) {
+		return -1;
+	}
+
+	if (sizeof(blake2bp_state) > sizeof(snowshoe_prehash)) {
+		return -1;
+	}
+
+	if (sizeof(ufe) != 32) {
+		return -1;
+	}
+
+	// Use SIMD hashing if the CPU has it, before the self-test checks it
+	blake2b_select_simd();
+
+	if (!self_test()) {
+		return -1;
+	}
+
+	return (expected_version == SNOWSHOE_VERSION) ? 0 : -1;
+}
+
+int snowshoe_init_tables(int size_class) {
+	switch (size_class) {
+	case SNOWSHOE_TABLES_SMALL:
+		ec_use_tables_large(0, 0);
+		return 0;
+
+	case SNOWSHOE_TABLES_LARGE:
+		break;
+
+	default:
+		return -1;
+	}
+
+	if (!m_large_tables) {
+		void *mem = tables_alloc(LARGE_TABLES_BYTES);
+		if (!mem) {
+			return -1;
+		}
+
+		ec_gen_tables_large((ecpt_affine *)mem, (ecpt_z1 *)((u8 *)mem + GEN_TABLE_LARGE_BYTES));
+
+		if (!tables_protect(mem, LARGE_TABLES_BYTES)) {
+			tables_free(mem, LARGE_TABLES_BYTES);
+			return -1;
+		}
+
+		m_large_tables = mem;
+	}
+
+	ec_use_tables_large((const ecpt_affine *)m_large_tables,
+						(const ecpt_z1 *)((const u8 *)m_large_tables + GEN_TABLE_LARGE_BYTES));
+
+	return 0;
+}
+
+void snowshoe_secret_gen(char k_chars[32]) {
+	// Operate on input in-place to avoid making waste variables
+	u64 *kq = (u64 *)k_chars;
+
+#ifndef CAT_ENDIAN_LITTLE
+	ec_load_k(k_chars, kq);
+#endif // CAT_ENDIAN_LITTLE
+
+	ec_mask_scalar(kq);
+
+#ifndef CAT_ENDIAN_LITTLE
+	ec_save_k(kq, k_chars);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+void snowshoe_mul_mod_q(const char x[32], const char y[32], const char z[32], char r[32]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 x1[4+4+4];
+	u64 *y1 = x1 + 4;
+	u64 *z1 = x1 + 8;
+
+	ec_load_k(x, x1);
+	ec_load_k(y, y1);
+	if (z) {
+		ec_load_k(z, z1);
+	}
+
+	mul_mod_q(x1, y1, z ? z1 : 0, x1);
+
+	ec_save_k(x1, r);
+
+	CAT_SECURE_OBJCLR(x1);
+#else
+	mul_mod_q((const u64 *)x, (const u64 *)y, (const u64 *)z, (u64 *)r);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+void snowshoe_add_mod_q(const char x[32], const char y[32], char r[32]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 x1[4+4];
+	u64 *y1 = x1 + 4;
+
+	ec_load_k(x, x1);
+	ec_load_k(y, y1);
+
+	add_mod_q(x1, y1, x1);
+
+	ec_save_k(x1, r);
+
+	CAT_SECURE_OBJCLR(x1);
+#else
+	add_mod_q((const u64 *)x, (const u64 *)y, (u64 *)r);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+void snowshoe_mod_q(const char x[64], char r[32]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 x1[8];
+
+	const u64 *k_raw = reinterpret_cast<const u64 *>( x );
+	x1[0] = getLE(k_raw[0]);
+	x1[1] = getLE(k_raw[1]);
+	x1[2] = getLE(k_raw[2]);
+	x1[3] = getLE(k_raw[3]);
+	x1[4] = getLE(k_raw[4]);
+	x1[5] = getLE(k_raw[5]);
+	x1[6] = getLE(k_raw[6]);
+	x1[7] = getLE(k_raw[7]);
+
+	mod_q(x1, x1);
+
+	ec_save_k(x1, r);
+
+	CAT_SECURE_OBJCLR(x1);
+#else
+	mod_q((const u64 *)x, (u64 *)r);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+void snowshoe_neg(const char P[64], char R[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8 *)P, p1);
+
+	// Run the math routine
+	ec_neg_affine(p1, p1);
+
+	// Save result endian-neutral
+	ec_save_xy(p1, (u8 *)R);
+
+	CAT_SECURE_OBJCLR(p1); // Maybe unnecessary for all use cases
+#else
+	ec_neg_affine(*(const ecpt_affine *)P, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+int snowshoe_valid(const char P[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
+
+	// If point is invalid,
+	if (!ec_valid_vartime(p1)) {
+		return -1;
+	}
+
+	CAT_SECURE_OBJCLR(p1); // Maybe unnecessary for all use cases
+#else
+	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
+		return -1;
+	}
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_mul_gen(const char k_raw[32], char R[64], char mul4) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// R = [4]kG
+	ecpt_affine r;
+	ecpt p;
+	ufe p2b;
+	ec_mul_gen(k, p, p2b);
+	if (mul4 != 0) {
+		ec_dbl(p, p, false, p2b);
+		ec_dbl(p, p, false, p2b);
+	}
+	ec_affine(p, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// R = [4]kG
+	ecpt p;
+	ufe p2b;
+	ec_mul_gen(k, p, p2b);
+	if (mul4 != 0) {
+		ec_dbl(p, p, false, p2b);
+		ec_dbl(p, p, false, p2b);
+	}
+	ec_affine(p, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_keygen_batch(const char seeds[][32], int n, char k[][32], char P[][64]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+	u64 kq[EC_MUL_MANY_CHUNK][4];
+	ecpt_affine r[EC_MUL_MANY_CHUNK];
+	ecpt X[EC_MUL_MANY_CHUNK];
+	ufe zs[EC_MUL_MANY_CHUNK];
+
+	for (int offset = 0; offset < n; offset += EC_MUL_MANY_CHUNK) {
+		const int count = (n - offset < EC_MUL_MANY_CHUNK) ? n - offset : EC_MUL_MANY_CHUNK;
+
+		// k = snowshoe_secret_gen(seed)
+		for (int ii = 0; ii < count; ++ii) {
+			char *ki = k[offset + ii];
+			memmove(ki, seeds[offset + ii], 32);
+			snowshoe_secret_gen(ki);
+
+#ifndef CAT_ENDIAN_LITTLE
+			ec_load_k(ki, kq[ii]);
+#else
+			memcpy(kq[ii], ki, 32);
+#endif // CAT_ENDIAN_LITTLE
+
+			// Validate key
+			if (invalid_key(kq[ii])) {
+				CAT_SECURE_OBJCLR(kq);
+				CAT_SECURE_OBJCLR(X);
+				CAT_SECURE_OBJCLR(zs);
+				return -1;
+			}
+		}
+
+		// P = k*G
+		ec_mul_gen_many_affine(kq, count, X, zs, r);
+
+		for (int ii = 0; ii < count; ++ii) {
+#ifndef CAT_ENDIAN_LITTLE
+			ec_save_xy(r[ii], (u8*)P[offset + ii]);
+#else
+			memcpy(P[offset + ii], &r[ii], 64);
+#endif // CAT_ENDIAN_LITTLE
+		}
+	}
+
+	CAT_SECURE_OBJCLR(kq);
+	CAT_SECURE_OBJCLR(X);
+	CAT_SECURE_OBJCLR(zs);
+
+	return 0;
+}
+
+int snowshoe_mul(const char k_raw[32], const char P[64], char R[64]) {
+	cache_header *cache = m_point_cache;
+	if (cache) {
+		return cache_mul(cache, k_raw, P, R);
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Load point
+	ecpt_affine p1, r;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_affine(k, p1, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Validate point
+	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_affine(k, *(const ecpt_affine *)P, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_mul_many_points(const char k_raw[32], const char P[][64], int n, char R[][64]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Validate points
+	ecpt_affine p1[EC_MUL_MANY_CHUNK], r[EC_MUL_MANY_CHUNK];
+	for (int ii = 0; ii < n; ++ii) {
+		ec_load_xy((const u8*)P[ii], p1[0]);
+
+		if (!ec_valid(p1[0])) {
+			return -1;
+		}
+	}
+
+	for (int offset = 0; offset < n; offset += EC_MUL_MANY_CHUNK) {
+		const int count = (n - offset < EC_MUL_MANY_CHUNK) ? n - offset : EC_MUL_MANY_CHUNK;
+
+		// Load points
+		for (int ii = 0; ii < count; ++ii) {
+			ec_load_xy((const u8*)P[offset + ii], p1[ii]);
+		}
+
+		// Multiply
+		ec_mul_many_affine(k, p1, count, r);
+
+		// Save results endian-neutral
+		for (int ii = 0; ii < count; ++ii) {
+			ec_save_xy(r[ii], (u8*)R[offset + ii]);
+		}
+	}
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k = (const u64 *)k_raw;
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Validate points
+	for (int ii = 0; ii < n; ++ii) {
+		if (!ec_valid_vartime(p1[ii])) {
+			return -1;
+		}
+	}
+
+	// Multiply
+	ec_mul_many_affine(k, p1, n, (ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_mul_batch(const char k_raw[][32], const char P[][64], int n, char R[][64], int status[]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+	cache_header *cache = m_point_cache;
+	if (cache) {
+		return cache_mul_batch(cache, k_raw, P, n, R, status);
+	}
+
+	u64 k[EC_MUL_MANY_CHUNK][4];
+	ecpt_affine p1[EC_MUL_MANY_CHUNK], r[EC_MUL_MANY_CHUNK];
+	int failures = 0;
+
+	for (int offset = 0; offset < n; offset += EC_MUL_MANY_CHUNK) {
+		const int count = (n - offset < EC_MUL_MANY_CHUNK) ? n - offset : EC_MUL_MANY_CHUNK;
+
+		// Load and validate inputs
+		for (int ii = 0; ii < count; ++ii) {
+			const int jj = offset + ii;
+
+#ifndef CAT_ENDIAN_LITTLE
+			ec_load_k(k_raw[jj], k[ii]);
+			ec_load_xy((const u8*)P[jj], p1[ii]);
+
+			const bool valid = !invalid_key(k[ii]) && ec_valid(p1[ii]);
+#else
+			memcpy(k[ii], k_raw[jj], 32);
+			p1[ii] = *(const ecpt_affine *)P[jj];
+
+			const bool valid = !invalid_key(k[ii]) && ec_valid_vartime(p1[ii]);
+#endif // CAT_ENDIAN_LITTLE
+
+			// Evaluate invalid entries as 1*G, so that each entry takes the same time
+			if (!valid) {
+				k[ii][0] = 1;
+				k[ii][1] = k[ii][2] = k[ii][3] = 0;
+				fe_set(EC_G.x, p1[ii].x);
+				fe_set(EC_G.y, p1[ii].y);
+				++failures;
+			}
+
+			status[jj] = valid ? 0 : -1;
+		}
+
+		// Multiply
+		ec_mul_batch_affine(k, p1, count, r);
+
+		// Store results, with zeroes for invalid entries
+		for (int ii = 0; ii < count; ++ii) {
+			const int jj = offset + ii;
+
+			if (status[jj] != 0) {
+				memset(R[jj], 0, 64);
+				continue;
+			}
+
+#ifndef CAT_ENDIAN_LITTLE
+			ec_save_xy(r[ii], (u8*)R[jj]);
+#else
+			memcpy(R[jj], &r[ii], 64);
+#endif // CAT_ENDIAN_LITTLE
+		}
+	}
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(r);
+
+	return failures ? -1 : 0;
+}
+
+int snowshoe_point_table_init(const char P[64], snowshoe_point_table *table) {
+	// Table memory must be aligned for the constant-time scans
+	if (((size_t)table & 63) != 0) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	ec_gen_point_table(p1, *(ec_point_table *)table);
+#else
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+
+	// Validate point
+	if (!ec_valid_vartime(*p1)) {
+		return -1;
+	}
+
+	ec_gen_point_table(*p1, *(ec_point_table *)table);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_mul_with_table(const char k_raw[32], const snowshoe_point_table *table, char R[64]) {
+	const ec_point_table *T = (const ec_point_table *)table;
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Multiply
+	ecpt_affine r;
+	ec_mul_table_affine(k, *T, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_table_affine(k, *T, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_keypair_init(const char k_raw[32], snowshoe_keypair *kp) {
+	// Key pair memory must be aligned for the constant-time scans of its table
+	if (((size_t)kp & 63) != 0) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	ec_gen_keypair(k, *(ec_keypair *)kp);
+
+	CAT_SECURE_OBJCLR(k);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	ec_gen_keypair(k, *(ec_keypair *)kp);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+void snowshoe_keypair_destroy(snowshoe_keypair *kp) {
+	CAT_SECURE_OBJCLR(*kp);
+}
+
+void snowshoe_keypair_public(const snowshoe_keypair *kp, char P[64]) {
+	const ec_keypair *K = (const ec_keypair *)kp;
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Save result endian-neutral
+	ec_save_xy(K->pub, (u8*)P);
+#else
+	*(ecpt_affine *)P = K->pub;
+#endif // CAT_ENDIAN_LITTLE
+}
+
+const snowshoe_point_table *snowshoe_keypair_table(const snowshoe_keypair *kp) {
+	const ec_keypair *K = (const ec_keypair *)kp;
+
+	return (const snowshoe_point_table *)&K->pub_table;
+}
+
+int snowshoe_keypair_mul(const snowshoe_keypair *kp, const char P[64], char R[64]) {
+	const ec_keypair *K = (const ec_keypair *)kp;
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1, r;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_recoded_affine(K->mul, K->recode_bit, p1, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	// Validate point
+	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_recoded_affine(K->mul, K->recode_bit, *(const ecpt_affine *)P, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_keypair_simul(const snowshoe_keypair *kp, const char P[64], const char b[32], const char Q[64], char R[64]) {
+	const ec_keypair *K = (const ec_keypair *)kp;
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k2[4];
+	ec_load_k(b, k2);
+
+	// Validate key
+	if (invalid_key(k2)) {
+		return -1;
+	}
+
+	// Load points
+	ecpt_affine p1, p2, r;
+	ec_load_xy((const u8*)P, p1);
+	ec_load_xy((const u8*)Q, p2);
+
+	// Validate points
+	if (!ec_valid(p1) || !ec_valid(p2)) {
+		return -1;
+	}
+
+	// Decompose scalar into subscalars
+	ec_decomp db;
+	gls_decompose(k2, db.asign, db.a, db.bsign, db.b);
+
+	// Multiply
+	ec_simul_decomposed_affine(K->simul, p1, db, p2, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k2);
+	CAT_SECURE_OBJCLR(db);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k2 = (const u64 *)b;
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+	const ecpt_affine *p2 = (const ecpt_affine *)Q;
+
+	// Validate key
+	if (invalid_key(k2)) {
+		return -1;
+	}
+
+	// Validate points
+	if (!ec_valid_vartime(*p1) || !ec_valid_vartime(*p2)) {
+		return -1;
+	}
+
+	// Decompose scalar into subscalars
+	ec_decomp db;
+	gls_decompose(k2, db.asign, db.a, db.bsign, db.b);
+
+	// Multiply
+	ec_simul_decomposed_affine(K->simul, *p1, db, *p2, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_point_cache_bytes(int entries) {
+	if (entries < 1 || entries > CACHE_MAX_SETS * CACHE_WAYS) {
+		return 0;
+	}
+
+	return cache_bytes(cache_sets(entries));
+}
+
+int snowshoe_point_cache_create(int entries, void *cache) {
+	if (entries < 1 || entries > CACHE_MAX_SETS * CACHE_WAYS) {
+		return -1;
+	}
+
+	// Table memory must be aligned for the constant-time scans
+	if (((size_t)cache & 63) != 0) {
+		return -1;
+	}
+
+	cache_init(cache_sets(entries), (cache_header *)cache);
+
+	return 0;
+}
+
+void snowshoe_point_cache_attach(void *cache) {
+	m_point_cache = (cache_header *)cache;
+}
+
+int snowshoe_mul_cached(const char k_raw[32], const char P[64], void *cache, char R[64]) {
+	return cache_mul((cache_header *)cache, k_raw, P, R);
+}
+
+void snowshoe_point_cache_stats(const void *cache, unsigned long long *hits, unsigned long long *misses) {
+	const cache_header *c = (const cache_header *)cache;
+	cache_set *set = (cache_set *)(c + 1);
+
+	*hits = 0;
+	*misses = 0;
+	for (u64 ii = 0; ii < c->sets; ++ii) {
+		*hits += pool_load64(set[ii].hits);
+		*misses += pool_load64(set[ii].misses);
+	}
+}
+
+int snowshoe_store_append(const char *path, const char P[64]) {
+	store_entry entry;
+	CAT_OBJCLR(entry);
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	ec_gen_point_table(p1, entry.table);
+#else
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+
+	// Validate point
+	if (!ec_valid_vartime(*p1)) {
+		return -1;
+	}
+
+	ec_gen_point_table(*p1, entry.table);
+#endif // CAT_ENDIAN_LITTLE
+
+	const u64 *key = (const u64 *)P;
+	for (int ii = 0; ii < 8; ++ii) {
+		entry.key[ii] = key[ii];
+	}
+	entry.check = store_checksum(entry);
+
+	FILE *f = fopen(path, "a+b");
+	if (!f) {
+		return -1;
+	}
+
+	bool ok = fseek(f, 0, SEEK_END) == 0;
+	const long size = ok ? ftell(f) : -1;
+
+	if (size == 0) {
+		// New file: Write the header first
+		store_header h;
+		store_header_init(h);
+		ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	} else if (size >= (long)sizeof(store_header)) {
+		// Existing file: Check that it is from this build
+		store_header h;
+		ok = fseek(f, 0, SEEK_SET) == 0 && fread(&h, sizeof(h), 1, f) == 1 && store_header_ok(h);
+
+		// Writes always go to the end, but switching from reading needs a seek
+		ok = ok && fseek(f, 0, SEEK_END) == 0;
+
+		// Complete any partial entry with zeroes so that it fails its checksum
+		const long partial = (size - (long)sizeof(store_header)) % (long)sizeof(store_entry);
+		if (ok && partial != 0) {
+			static const u8 zero[sizeof(store_entry)] = {0};
+			ok = fwrite(zero, sizeof(store_entry) - partial, 1, f) == 1;
+		}
+	} else {
+		ok = false;
+	}
+
+	if (ok) {
+		ok = fwrite(&entry, sizeof(entry), 1, f) == 1;
+	}
+
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+
+	return ok ? 0 : -1;
+}
+
+snowshoe_table_store *snowshoe_store_open(const char *path) {
+	u64 map_bytes;
+	const u8 *map = store_map(path, map_bytes);
+	if (!map) {
+		return 0;
+	}
+
+	if (!store_header_ok(*(const store_header *)map)) {
+		store_unmap(map, map_bytes);
+		return 0;
+	}
+
+	u64 n = (map_bytes - sizeof(store_header)) / sizeof(store_entry);
+	if (n > STORE_MAX_ENTRIES) {
+		n = STORE_MAX_ENTRIES;
+	}
+
+	// Hash index at most half full
+	u32 size = 2;
+	while (size < 2 * n) {
+		size <<= 1;
+	}
+
+	store_handle *store = new (std::nothrow) store_handle;
+	u32 *index = new (std::nothrow) u32[size];
+	if (!store || !index) {
+		delete []index;
+		delete store;
+		store_unmap(map, map_bytes);
+		return 0;
+	}
+
+	store->map = map;
+	store->map_bytes = map_bytes;
+	store->entries = (const store_entry *)(map + sizeof(store_header));
+	store->count = 0;
+	store->mask = size - 1;
+	store->index = index;
+	memset(index, 0, size * sizeof(u32));
+
+	// Index every entry that passes its checksum
+	for (u32 ii = 0; ii < (u32)n; ++ii) {
+		const store_entry &e = store->entries[ii];
+
+		if (e.check != store_checksum(e)) {
+			continue;
+		}
+
+		u32 slot = (u32)ec_point_hash(e.key) & store->mask;
+		while (index[slot] != 0) {
+			slot = (slot + 1) & store->mask;
+		}
+		index[slot] = ii + 1;
+		store->count++;
+	}
+
+	return (snowshoe_table_store *)store;
+}
+
+const snowshoe_point_table *snowshoe_store_find(const snowshoe_table_store *handle, const char P[64]) {
+	store_handle *store = (store_handle *)handle;
+	const u64 *key = (const u64 *)P;
+	const u32 *index = store->index;
+
+	for (u32 slot = (u32)ec_point_hash(key) & store->mask; index[slot] != 0; slot = (slot + 1) & store->mask) {
+		const store_entry &e = store->entries[index[slot] - 1];
+
+		u64 diff = 0;
+		for (int ii = 0; ii < 8; ++ii) {
+			diff |= e.key[ii] ^ key[ii];
+		}
+
+		if (diff == 0) {
+			return (const snowshoe_point_table *)&e.table;
+		}
+	}
+
+	return 0;
+}
+
+int snowshoe_store_count(const snowshoe_table_store *handle) {
+	const store_handle *store = (const store_handle *)handle;
+
+	return (int)store->count;
+}
+
+void snowshoe_store_close(snowshoe_table_store *handle) {
+	store_handle *store = (store_handle *)handle;
+
+	if (store) {
+		store_unmap(store->map, store->map_bytes);
+		delete []store->index;
+		delete store;
+	}
+}
+
+int snowshoe_fixed_base_bytes(int size_class) {
+	switch (size_class) {
+	case SNOWSHOE_TABLES_SMALL:
+		return ec_fixed_base_bytes(MG_v);
+	case SNOWSHOE_TABLES_LARGE:
+		return ec_fixed_base_bytes(MG_d);
+	}
+
+	return 0;
+}
+
+int snowshoe_fixed_base_create(const char P[64], int size_class, void *table) {
+	int v;
+	switch (size_class) {
+	case SNOWSHOE_TABLES_SMALL:
+		v = MG_v;
+		break;
+	case SNOWSHOE_TABLES_LARGE:
+		v = MG_d;
+		break;
+	default:
+		return -1;
+	}
+
+	// Table memory must be aligned for the constant-time scans
+	if (((size_t)table & 63) != 0) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	ec_gen_fixed_base(p1, v, (ec_fixed_base *)table);
+#else
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+
+	// Validate point
+	if (!ec_valid_vartime(*p1)) {
+		return -1;
+	}
+
+	ec_gen_fixed_base(*p1, v, (ec_fixed_base *)table);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_fixed_base_mul(const char k_raw[32], const void *table, char R[64]) {
+	const ec_fixed_base *fb = (const ec_fixed_base *)table;
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Multiply
+	ecpt_affine r;
+	ec_mul_fixed_base_affine(k, fb, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_mul_fixed_base_affine(k, fb, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_fixed_base_simul_gen(const char a[32], const char b[32], const void *table, char R[64]) {
+	const ec_fixed_base *fb = (const ec_fixed_base *)table;
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k1[4], k2[4];
+	ec_load_k(a, k1);
+	ec_load_k(b, k2);
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Multiply
+	ecpt_affine r;
+	ec_simul_gen_fixed_base_affine(k1, k2, fb, false, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_gen_fixed_base_affine(k1, k2, fb, false, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_commit(const char a[32], const char b[32], const void *H_table, char R[64]) {
+	const ec_fixed_base *fb = (const ec_fixed_base *)H_table;
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k1[4], k2[4];
+	ec_load_k(a, k1);
+	ec_load_k(b, k2);
+
+	// Validate keys (value a may be zero)
+	if (!less_q(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Multiply
+	ecpt_affine r;
+	ec_simul_gen_fixed_base_affine(k1, k2, fb, true, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k1);
+	CAT_SECURE_OBJCLR(k2);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+
+	// Validate keys (value a may be zero)
+	if (!less_q(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_gen_fixed_base_affine(k1, k2, fb, true, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_simul_gen(const char a[32], const char b[32], const char Q[64], char R[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k1[4+4];
+	u64 *k2 = k1 + 4;
+	ec_load_k(a, k1);
+	ec_load_k(b, k2);
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Load point
+	ecpt_affine p2, r;
+	ec_load_xy((const u8*)Q, p2);
+
+	// Validate point
+	if (!ec_valid(p2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_gen_wnaf_affine(k1, k2, p2, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	// May not needed in all use cases
+	CAT_SECURE_OBJCLR(k1);
+	CAT_SECURE_OBJCLR(p2);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+	const ecpt_affine *p2 = (const ecpt_affine *)Q;
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Validate point
+	if (!ec_valid_vartime(*p2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_gen_wnaf_affine(k1, k2, *p2, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_simul(const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]) {
+	cache_header *cache = m_point_cache;
+	if (cache) {
+		return cache_simul(cache, a, P, b, Q, R);
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k1[4], k2[4];
+	ec_load_k(a, k1);
+	ec_load_k(b, k2);
+
+	// Validate keys
+	if (invalid_key(k1) || invalid_key(k2)) {
+		return -1;
+	}
+
+	// Load points
+	ecpt_affine p1, p2, r;
+	ec_load_xy((const u8*)P, p1);
+	ec_load_xy((const u8*)Q, p2);
+
+	// Validate points
+	if (!ec_valid(p1) || !ec_valid(p2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_affine(k1, p1, k2, p2, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+	const ecpt_affine *p2 = (const ecpt_affine *)Q;
 
 	// Validate keys
 	if (invalid_key(k1) || invalid_key(k2)) {
 		return -1;
 	}
 
+	// Validate points
+	if (!ec_valid_vartime(*p1) || !ec_valid_vartime(*p2)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_affine(k1, *p1, k2, *p2, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_simul_half(const char k_raw[32], const char P[64], char H[128]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
 	// Load point
-	ecpt_affine p2, r;
-	ec_load_xy((const u8*)Q, p2);
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
 
 	// Validate point
-	if (!ec_valid(p2)) {
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_half(k, p1, *(ecpt *)H);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+#else
+	const u64 *k = (const u64 *)k_raw;
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Validate point
+	if (!ec_valid_vartime(*(const ecpt_affine *)P)) {
+		return -1;
+	}
+
+	// Multiply
+	ec_simul_half(k, *(const ecpt_affine *)P, *(ecpt *)H);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+void snowshoe_simul_join(const char H1[128], const char H2[128], char R[64]) {
+	const ecpt *h1 = (const ecpt *)H1;
+	const ecpt *h2 = (const ecpt *)H2;
+
+#ifndef CAT_ENDIAN_LITTLE
+	ecpt_affine r;
+	ec_simul_join_affine(*h1, *h2, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(r);
+#else
+	ec_simul_join_affine(*h1, *h2, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+}
+
+int snowshoe_simul_n(const char k[][32], const char P[][64], int n, char R[64]) {
+	if (n < 3 || n > EC_SIMUL_N_MAX) {
+		return -1;
+	}
+
+#ifndef CAT_ENDIAN_LITTLE
+	u64 kv[EC_SIMUL_N_MAX][4];
+	ecpt_affine pv[EC_SIMUL_N_MAX], r;
+
+	for (int ii = 0; ii < n; ++ii) {
+		ec_load_k(k[ii], kv[ii]);
+
+		// Validate key
+		if (invalid_key(kv[ii])) {
+			return -1;
+		}
+
+		// Load point
+		ec_load_xy((const u8*)P[ii], pv[ii]);
+
+		// Validate point
+		if (!ec_valid(pv[ii])) {
+			return -1;
+		}
+	}
+
+	// Multiply
+	ec_simul_n_affine(kv, pv, n, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)R);
+
+	CAT_SECURE_OBJCLR(kv);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 (*kv)[4] = (const u64 (*)[4])k;
+	const ecpt_affine *pv = (const ecpt_affine *)P;
+
+	for (int ii = 0; ii < n; ++ii) {
+		// Validate key
+		if (invalid_key(kv[ii])) {
+			return -1;
+		}
+
+		// Validate point
+		if (!ec_valid_vartime(pv[ii])) {
+			return -1;
+		}
+	}
+
+	// Multiply
+	ec_simul_n_affine(kv, pv, n, *(ecpt_affine *)R);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_dhfs_server(const char sk_s[32], const char sk_e[32], const char h[32], const char pp_c[64], char pp_e[64], char sp[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4+4+4];
+	u64 *s = k + 4;
+	u64 *e = k + 8;
+	ec_load_k(h, k);
+	ec_load_k(sk_s, s);
+	ec_load_k(sk_e, e);
+
+	// Validate keys
+	if (invalid_key(s) || invalid_key(e)) {
+		return -1;
+	}
+
+	// Load point
+	ecpt_affine p1, r[2];
+	ec_load_xy((const u8*)pp_c, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	// d = e + h * s (mod q)
+	mul_mod_q(k, s, e, k);
+	if (is_zero(k)) {
+		return -1;
+	}
+
+	// pp_e = eG, sp = 4d * pp_c
+	ec_mul_gen_mul_affine(e, k, p1, r);
+
+	// Save results endian-neutral
+	ec_save_xy(r[0], (u8*)pp_e);
+	ec_save_xy(r[1], (u8*)sp);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *s = (const u64 *)sk_s;
+	const u64 *e = (const u64 *)sk_e;
+	const ecpt_affine *p1 = (const ecpt_affine *)pp_c;
+
+	// Validate keys
+	if (invalid_key(s) || invalid_key(e)) {
+		return -1;
+	}
+
+	// Validate point
+	if (!ec_valid_vartime(*p1)) {
+		return -1;
+	}
+
+	// d = e + h * s (mod q)
+	u64 d[4];
+	mul_mod_q((const u64 *)h, s, e, d);
+	if (is_zero(d)) {
+		return -1;
+	}
+
+	// pp_e = eG, sp = 4d * pp_c
+	ecpt_affine r[2];
+	ec_mul_gen_mul_affine(e, d, *p1, r);
+
+	*(ecpt_affine *)pp_e = r[0];
+	*(ecpt_affine *)sp = r[1];
+
+	CAT_SECURE_OBJCLR(d);
+	CAT_SECURE_OBJCLR(r);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_dhfs_client(const char sk_c[32], const char h[32], const char pp_e[64], const char pp_s[64], char sp[64]) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4+4];
+	u64 *a = k + 4;
+	ec_load_k(sk_c, k);
+	ec_load_k(h, a);
+
+	// Validate key
+	if (invalid_key(k)) {
+		return -1;
+	}
+
+	// Load points
+	ecpt_affine p1, p2, r;
+	ec_load_xy((const u8*)pp_e, p1);
+	ec_load_xy((const u8*)pp_s, p2);
+
+	// Validate points
+	if (!ec_valid(p1) || !ec_valid(p2)) {
+		return -1;
+	}
+
+	// a = h * c (mod q)
+	mul_mod_q(a, k, 0, a);
+	if (is_zero(a)) {
+		return -1;
+	}
+
+	// sp = 4c * pp_e + 4a * pp_s
+	ec_simul_affine(k, p1, a, p2, r);
+
+	// Save result endian-neutral
+	ec_save_xy(r, (u8*)sp);
+
+	CAT_SECURE_OBJCLR(k);
+	CAT_SECURE_OBJCLR(p1);
+	CAT_SECURE_OBJCLR(r);
+#else
+	const u64 *c = (const u64 *)sk_c;
+	const ecpt_affine *p1 = (const ecpt_affine *)pp_e;
+	const ecpt_affine *p2 = (const ecpt_affine *)pp_s;
+
+	// Validate key
+	if (invalid_key(c)) {
+		return -1;
+	}
+
+	// Validate points
+	if (!ec_valid_vartime(*p1) || !ec_valid_vartime(*p2)) {
+		return -1;
+	}
+
+	// a = h * c (mod q)
+	u64 a[4];
+	mul_mod_q((const u64 *)h, c, 0, a);
+	if (is_zero(a)) {
+		return -1;
+	}
+
+	// sp = 4c * pp_e + 4a * pp_s
+	ec_simul_affine(c, *p1, a, *p2, *(ecpt_affine *)sp);
+
+	CAT_SECURE_OBJCLR(a);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_point_load(const char P[64], snowshoe_point *H) {
+#ifndef CAT_ENDIAN_LITTLE
+	// Load point
+	ecpt_affine p1;
+	ec_load_xy((const u8*)P, p1);
+
+	// Validate point
+	if (!ec_valid(p1)) {
+		return -1;
+	}
+
+	ec_expand(p1, *(ecpt *)H);
+#else
+	const ecpt_affine *p1 = (const ecpt_affine *)P;
+
+	// Validate point
+	if (!ec_valid_vartime(*p1)) {
+		return -1;
+	}
+
+	ec_expand(*p1, *(ecpt *)H);
+#endif // CAT_ENDIAN_LITTLE
+
+	return 0;
+}
+
+int snowshoe_point_mul_gen(const char k_raw[32], snowshoe_point *R, char mul4) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
+#else
+	const u64 *k = (const u64 *)k_raw;
+#endif // CAT_ENDIAN_LITTLE
+
+	// Validate key
+	if (invalid_key(k)) {
 		return -1;
 	}
 
-	// Multiply
-	ec_simul_gen_affine(k1, k2, p2, r);
+	// R = [4]kG
+	ecpt p;
+	ufe p2b;
+	ec_mul_gen(k, p, p2b);
+	if (mul4 != 0) {
+		ec_dbl(p, p, false, p2b);
+		ec_dbl(p, p, false, p2b);
+	}
+
+	// Fix T coordinate
+	fe_mul(p.t, p2b, p.t);
+
+	ec_set(p, *(ecpt *)R);
+
+#ifndef CAT_ENDIAN_LITTLE
+	CAT_SECURE_OBJCLR(k);
+#endif // CAT_ENDIAN_LITTLE
 
-	// Save result endian-neutral
-	ec_save_xy(r, (u8*)R);
+	return 0;
+}
 
-	// May not needed in all use cases
-	CAT_SECURE_OBJCLR(k1);
-	CAT_SECURE_OBJCLR(p2);
-	CAT_SECURE_OBJCLR(r);
+int snowshoe_point_mul(const char k_raw[32], const snowshoe_point *P, snowshoe_point *R) {
+#ifndef CAT_ENDIAN_LITTLE
+	u64 k[4];
+	ec_load_k(k_raw, k);
 #else
-	const u64 *k1 = (const u64 *)a;
-	const u64 *k2 = (const u64 *)b;
-	const ecpt_affine *p2 = (const ecpt_affine *)Q;
-
-	// Validate keys
-	if (invalid_key(k1) || invalid_key(k2)) {
-		return -1;
-	}
+	const u64 *k = (const u64 *)k_raw;
+#endif // CAT_ENDIAN_LITTLE
 
-	// Validate point
-	if (!ec_valid_vartime(*p2)) {
+	// Validate key
+	if (invalid_key(k)) {
 		return -1;
 	}
 
 	// Multiply
-	ec_simul_gen_affine(k1, k2, *p2, *(ecpt_affine *)R);
+	ecpt r;
+	ec_mul_handle(k, *(const ecpt *)P, r);
+	ec_set(r, *(ecpt *)R);
+
+#ifndef CAT_ENDIAN_LITTLE
+	CAT_SECURE_OBJCLR(k);
 #endif // CAT_ENDIAN_LITTLE
 
 	return 0;
 }
 
-int snowshoe_simul(const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]) {
+int snowshoe_point_simul(const char a[32], const snowshoe_point *P, const char b[32], const snowshoe_point *Q, snowshoe_point *R) {
 #ifndef CAT_ENDIAN_LITTLE
 	u64 k1[4], k2[4];
 	ec_load_k(a, k1);
 	ec_load_k(b, k2);
+#else
+	const u64 *k1 = (const u64 *)a;
+	const u64 *k2 = (const u64 *)b;
+#endif // CAT_ENDIAN_LITTLE
 
 	// Validate keys
 	if (invalid_key(k1) || invalid_key(k2)) {
 		return -1;
 	}
 
-	// Load points
-	ecpt_affine p1, p2, r;
-	ec_load_xy((const u8*)P, p1);
-	ec_load_xy((const u8*)Q, p2);
+	// Multiply
+	ecpt r;
+	ec_simul_handle(k1, *(const ecpt *)P, k2, *(const ecpt *)Q, r);
+	ec_set(r, *(ecpt *)R);
 
-	// Validate points
-	if (!ec_valid(p1) || !ec_valid(p2)) {
-		return -1;
-	}
+#ifndef CAT_ENDIAN_LITTLE
+	CAT_SECURE_OBJCLR(k1);
+	CAT_SECURE_OBJCLR(k2);
+#endif // CAT_ENDIAN_LITTLE
 
-	// Multiply
-	ec_simul_affine(k1, p1, k2, p2, r);
+	return 0;
+}
 
-	// Save result endian-neutral
-	ec_save_xy(r, (u8*)R);
+void snowshoe_point_add(const snowshoe_point *P, const snowshoe_point *Q, snowshoe_point *R) {
+	ecpt r;
+	ec_add_handle(*(const ecpt *)P, *(const ecpt *)Q, r);
+	ec_set(r, *(ecpt *)R);
+}
 
-	CAT_SECURE_OBJCLR(k);
-	CAT_SECURE_OBJCLR(p1);
-	CAT_SECURE_OBJCLR(r);
-#else
-	const u64 *k1 = (const u64 *)a;
-	const u64 *k2 = (const u64 *)b;
-	const ecpt_affine *p1 = (const ecpt_affine *)P;
-	const ecpt_affine *p2 = (const ecpt_affine *)Q;
+void snowshoe_point_neg(const snowshoe_point *P, snowshoe_point *R) {
+	ec_neg(*(const ecpt *)P, *(ecpt *)R);
+}
 
-	// Validate keys
-	if (invalid_key(k1) || invalid_key(k2)) {
-		return -1;
+void snowshoe_point_dbl(const snowshoe_point *P, snowshoe_point *R) {
+	ecpt r;
+	ec_dbl_handle(*(const ecpt *)P, r);
+	ec_set(r, *(ecpt *)R);
+}
+
+void snowshoe_point_store(const snowshoe_point H[], int n, char R[][64]) {
+	if (n <= 0) {
+		return;
 	}
 
-	// Validate points
-	if (!ec_valid_vartime(*p1) || !ec_valid_vartime(*p2)) {
-		return -1;
+#ifndef CAT_ENDIAN_LITTLE
+	ecpt_affine r[EC_MUL_MANY_CHUNK];
+
+	for (int offset = 0; offset < n; offset += EC_MUL_MANY_CHUNK) {
+		const int count = (n - offset < EC_MUL_MANY_CHUNK) ? n - offset : EC_MUL_MANY_CHUNK;
+
+		ec_affine_handles((const ecpt *)(H + offset), count, r);
+
+		// Save results endian-neutral
+		for (int ii = 0; ii < count; ++ii) {
+			ec_save_xy(r[ii], (u8*)R[offset + ii]);
+		}
 	}
 
-	// Multiply
-	ec_simul_affine(k1, *p1, k2, *p2, *(ecpt_affine *)R);
+	CAT_SECURE_OBJCLR(r);
+#else
+	ec_affine_handles((const ecpt *)H, n, (ecpt_affine *)R);
 #endif // CAT_ENDIAN_LITTLE
-
-	return 0;
 }
 
 // E = Elligator(key)
@@ -626,21 +4028,47 @@ int snowshoe_elligator(const char key[32], char E[128]) {
 		return -1;
 	}
 
-	// q = 4E
-	ecpt q;
-	ec_expand(p, q);
-	ufe t2b;
-	ec_dbl(q, q, true, t2b);
-	ec_dbl(q, q, false, t2b);
+	// E = 4P
+	ec_elligator_expand(p, *(ecpt *)E);
 
-	// Fix T coordinate
-	fe_mul(q.t, t2b, q.t);
+	return 0;
+}
 
-	// Copy result
-	ecpt *e = (ecpt *)E;
-	ec_set(q, *e);
+int snowshoe_elligator_batch(const char keys[][32], int n, char E[][128], int status[]) {
+	if (n <= 0) {
+		return -1;
+	}
 
-	return 0;
+	int failed = 0;
+
+	for (int offset = 0; offset < n; offset += EC_ELLIGATOR_CHUNK) {
+		int count = n - offset;
+		if (count > EC_ELLIGATOR_CHUNK) {
+			count = EC_ELLIGATOR_CHUNK;
+		}
+
+		// Calculate Elligator points from keys
+		ecpt_affine p[EC_ELLIGATOR_CHUNK];
+		ec_elligator_decode_n(keys + offset, count, p);
+
+		for (int ii = 0; ii < count; ++ii) {
+			char *e = E[offset + ii];
+
+			// Validate the resulting point (ie. 0 -> invalid point)
+			if (!ec_valid_vartime(p[ii])) {
+				memset(e, 0, 128);
+				status[offset + ii] = -1;
+				++failed;
+				continue;
+			}
+
+			// E = 4P
+			ec_elligator_expand(p[ii], *(ecpt *)e);
+			status[offset + ii] = 0;
+		}
+	}
+
+	return failed ? -1 : 0;
 }
 
 // C = kG + E
@@ -713,6 +4141,328 @@ int snowshoe_elligator_secret(const char k1[32], const char C[64], const char E[
 	return 0;
 }
 
+// R = k(C - E) + k2 * V, where k is the key pair's private key
+int snowshoe_keypair_elligator_secret(const snowshoe_keypair *kp, const char C[64], const char E[128],
+									  const char k2[32], const char V[64], char R[64]) {
+	const ec_keypair *K = (const ec_keypair *)kp;
+
+	// p = C - E
+	ecpt p, q;
+	const ecpt_affine *c = (const ecpt_affine *)C;
+	if (!ec_valid_vartime(*c)) {
+		return -1;
+	}
+	ec_expand(*c, p);
+	const ecpt *e = (const ecpt *)E;
+	ec_neg(*e, q);
+	ufe t2b;
+	ec_add(q, p, p, true, true, true, t2b);
+
+	// If only a single multiplication is required,
+	if (!k2) {
+		// p = k * p
+		ec_mul_recoded(K->mul, K->recode_bit, p, false, p, t2b);
+	} else {
+		// q = V
+		const ecpt_affine *v = (const ecpt_affine *)V;
+		if (!ec_valid_vartime(*v)) {
+			return -1;
+		}
+		ec_expand(*v, q);
+
+		const u64 *key2 = (const u64 *)k2;
+		if (invalid_key(key2)) {
+			return -1;
+		}
+
+		// p = k * p + k2 * q
+		ec_decomp d2;
+		gls_decompose(key2, d2.asign, d2.a, d2.bsign, d2.b);
+		ec_simul_decomposed(K->simul, p, false, d2, q, true, p, t2b);
+
+		CAT_SECURE_OBJCLR(d2);
+	}
+
+	// Fix small subgroup attack
+	ec_dbl(p, p, false, t2b);
+	ec_dbl(p, p, false, t2b);
+
+	// Affine point
+	ecpt_affine *r = (ecpt_affine *)R;
+	ec_affine(p, *r);
+
+	return 0;
+}
+
+int snowshoe_sign_keygen(const char seed[32], char sk[64], char pk[64]) {
+	// hi,lo = H(seed)
+	blake2b_state S;
+	blake2b_init(S, BLAKE2B_OUTBYTES);
+	blake2b_update(S, seed, 32);
+	blake2b_final(S, (u8 *)sk);
+	CAT_SECURE_OBJCLR(S);
+
+	// a = snowshoe_secret_gen(lo)
+	snowshoe_secret_gen(sk);
+
+	// A = a*G
+	if (snowshoe_mul_gen(sk, pk, 0)) {
+		CAT_SECURE_CLR(sk, 64);
+		return -1;
+	}
+
+	return 0;
+}
+
+int snowshoe_sign(const char sk[64], const char pk[64], const void *msg, size_t bytes, char sig[96]) {
+	snowshoe_iovec iov;
+	iov.data = msg;
+	iov.bytes = bytes;
+
+	return sign_iov(sk, pk, &iov, 1, 0, sig);
+}
+
+int snowshoe_verify(const char pk[64], const void *msg, size_t bytes, const char sig[96]) {
+	snowshoe_iovec iov;
+	iov.data = msg;
+	iov.bytes = bytes;
+
+	return verify_iov(pk, &iov, 1, 0, sig);
+}
+
+int snowshoe_sign_iov(const char sk[64], const char pk[64], const snowshoe_iovec *iov, int count, char sig[96]) {
+	return sign_iov(sk, pk, iov, count, 0, sig);
+}
+
+int snowshoe_verify_iov(const char pk[64], const snowshoe_iovec *iov, int count, const char sig[96]) {
+	return verify_iov(pk, iov, count, 0, sig);
+}
+
+void snowshoe_prehash_init(snowshoe_prehash *ph) {
+	blake2bp_init(*(blake2bp_state *)ph);
+}
+
+void snowshoe_prehash_update(snowshoe_prehash *ph, const void *data, size_t bytes) {
+	blake2bp_update(*(blake2bp_state *)ph, data, bytes);
+}
+
+int snowshoe_sign_prehash(const char sk[64], const char pk[64], snowshoe_prehash *ph, char sig[96]) {
+	// D = H(M)
+	u8 D[BLAKE2B_OUTBYTES];
+	blake2bp_final(*(blake2bp_state *)ph, D);
+
+	snowshoe_iovec iov;
+	iov.data = D;
+	iov.bytes = sizeof(D);
+
+	return sign_iov(sk, pk, &iov, 1, SIGN_PREHASH_PERSONAL, sig);
+}
+
+int snowshoe_verify_prehash(const char pk[64], snowshoe_prehash *ph, const char sig[96]) {
+	// D = H(M)
+	u8 D[BLAKE2B_OUTBYTES];
+	blake2bp_final(*(blake2bp_state *)ph, D);
+
+	snowshoe_iovec iov;
+	iov.data = D;
+	iov.bytes = sizeof(D);
+
+	return verify_iov(pk, &iov, 1, SIGN_PREHASH_PERSONAL, sig);
+}
+
+snowshoe_pool *snowshoe_pool_create(int threads, const int *cpus) {
+	return (snowshoe_pool *)pool_create(threads, cpus);
+}
+
+void snowshoe_pool_destroy(snowshoe_pool *pool) {
+	if (pool) {
+		pool_destroy((pool_state *)pool);
+	}
+}
+
+int snowshoe_keygen_batch_parallel(snowshoe_pool *pool, const char seeds[][32], int n, char k[][32], char P[][64]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+	keygen_batch_job job;
+	job.seeds = seeds;
+	job.k = k;
+	job.P = P;
+
+	return pool_run((pool_state *)pool, keygen_batch_chunk, &job, n, POOL_CHUNK) ? -1 : 0;
+}
+
+int snowshoe_mul_batch_parallel(snowshoe_pool *pool, const char k[][32], const char P[][64], int n, char R[][64], int status[]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+	mul_batch_job job;
+	job.k = k;
+	job.P = P;
+	job.R = R;
+	job.status = status;
+
+	return pool_run((pool_state *)pool, mul_batch_chunk, &job, n, POOL_CHUNK) ? -1 : 0;
+}
+
+int snowshoe_verify_batch_parallel(snowshoe_pool *pool, const char pk[][64], const snowshoe_iovec msg[], const char sig[][96], int n, int status[]) {
+	if (n <= 0) {
+		return -1;
+	}
+
+	verify_batch_job job;
+	job.pk = pk;
+	job.msg = msg;
+	job.sig = sig;
+	job.status = status;
+
+	return pool_run((pool_state *)pool, verify_batch_chunk, &job, n, POOL_CHUNK) ? -1 : 0;
+}
+
+int snowshoe_simul_parallel(snowshoe_pool *pool, const char a[32], const char P[64], const char b[32], const char Q[64], char R[64]) {
+	// The split does more work in total, so it only pays off on two threads
+	if (!pool || ((pool_state *)pool)->threads <= 1) {
+		return snowshoe_simul(a, P, b, Q, R);
+	}
+
+	pool_state *p = (pool_state *)pool;
+
+	// If another caller has the slot, running serially is faster than waiting
+	if (!pool_cas(p->handoff, HANDOFF_IDLE, HANDOFF_CLAIMED)) {
+		return snowshoe_simul(a, P, b, Q, R);
+	}
+
+	// Post bQ for worker 1
+	ecpt H[2];
+	p->handoff_k = b;
+	p->handoff_P = Q;
+	p->handoff_H = &H[1];
+	pool_store(p->handoff, HANDOFF_POSTED);
+
+	if (pool_load(p->handoff_sleeping)) {
+		pool_lock(p->lock);
+		pool_wake_one(p->handoff_wake);
+		pool_unlock(p->lock);
+	}
+
+	// aP on this thread
+	int failed = snowshoe_simul_half(a, P, (char *)&H[0]);
+
+	// Take bQ back if worker 1 has not started it, or else wait for it
+	if (pool_cas(p->handoff, HANDOFF_POSTED, HANDOFF_CLAIMED)) {
+		failed |= snowshoe_simul_half(b, Q, (char *)&H[1]);
+	} else {
+		while (pool_load(p->handoff) != HANDOFF_DONE) {
+			pool_pause();
+		}
+		failed |= p->handoff_failed;
+	}
+
+	pool_store(p->handoff, HANDOFF_IDLE);
+
+	if (!failed) {
+		snowshoe_simul_join((const char *)&H[0], (const char *)&H[1], R);
+	}
+
+	CAT_SECURE_OBJCLR(H);
+
+	return failed ? -1 : 0;
+}
+
+snowshoe_queue *snowshoe_queue_create(int threads, int capacity) {
+	return (snowshoe_queue *)queue_create(threads, capacity);
+}
+
+void snowshoe_queue_destroy(snowshoe_queue *queue) {
+	if (queue) {
+		queue_destroy((queue_state *)queue);
+	}
+}
+
+int snowshoe_queue_fd(const snowshoe_queue *queue) {
+	return ((const queue_state *)queue)->fds[0];
+}
+
+int snowshoe_submit(snowshoe_queue *queue, snowshoe_job *job) {
+	queue_state *q = (queue_state *)queue;
+
+	if (pool_add(q->in_flight, 1) > (u32)q->capacity) {
+		pool_add(q->in_flight, (u32)-1);
+		return -1;
+	}
+
+	// Cannot fail while in_flight is within capacity
+	queue_push(q->pending, job);
+
+	if (pool_load(q->sleepers) != 0) {
+		pool_lock(q->lock);
+		pool_wake_one(q->wake);
+		pool_unlock(q->lock);
+	}
+
+	return 0;
+}
+
+int snowshoe_poll(snowshoe_queue *queue, snowshoe_job *done[], int max) {
+	queue_state *q = (queue_state *)queue;
+	int n = 0;
+
+	while (n < max && (done[n] = queue_pop(q->done)) != 0) {
+		++n;
+	}
+
+	if (n > 0) {
+		pool_add(q->in_flight, (u32)-n);
+	}
+
+	// Reset the signal once nothing is left, even if this call found nothing
+	if (pool_add(q->done_count, (u32)-n) == 0) {
+		queue_signal_clear(q);
+
+		// A worker may have counted more jobs and set the signal before the clear
+		if (pool_load(q->done_count) != 0) {
+			queue_signal_set(q);
+		}
+	}
+
+	return n;
+}
+
+snowshoe_ephemeral *snowshoe_ephemeral_create(int capacity, int low_water, snowshoe_random rng, void *context) {
+	return (snowshoe_ephemeral *)ephemeral_create(capacity, low_water, rng, context);
+}
+
+void snowshoe_ephemeral_destroy(snowshoe_ephemeral *pool) {
+	if (pool) {
+		ephemeral_destroy((ephemeral_state *)pool);
+	}
+}
+
+int snowshoe_ephemeral_pop(snowshoe_ephemeral *pool, char k[32], char P[64]) {
+	ephemeral_state *e = (ephemeral_state *)pool;
+
+	if (ephemeral_take(e, k, P)) {
+		return 0;
+	}
+
+	// Empty, so generate one here rather than wait for the producer
+	if (e->rng(e->rng_context, k, 32) != 0) {
+		return -1;
+	}
+	snowshoe_secret_gen(k);
+
+	return snowshoe_mul_gen(k, P, 0);
+}
+
+void snowshoe_ephemeral_stats(snowshoe_ephemeral *pool, unsigned long long *hits, unsigned long long *misses) {
+	ephemeral_state *e = (ephemeral_state *)pool;
+
+	*hits = pool_load64(e->hits);
+	*misses = pool_load64(e->misses);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -219,60 +219,91 @@ static bool ec_gen_tables_comb_test() {
 	return true;
 }
 
-static bool ec_gen_tables3_comb_test() {
-	//const int t = 252;
-	const int w = 8;
-	//const int e = 32; // ceil(t / wv)
-	const int d = 32; // e*v, v = 1
+static bool ec_gen_tables_wnaf_test() {
+	ecpt_z1 table[2][64];
 
-	ecpt_z1 table[128];
+	ufe t2b;
+	ecpt q, g2;
 
-	const int ul = 1 << (w - 1);
-	for (int u = 0; u < ul; ++u) {
-		// P[u][v'] = 2^(ev') * (1 + u0*2^d + ... + u_(w-2)*2^((w-1)*d)) * P
+	// g2 = 2G
+	ec_dbl(EC_G, g2, true, t2b);
+	ecpt_affine g2a;
+	ec_affine(g2, g2a);
+	ec_expand(g2a, g2);
 
-		// q = u * P
-		ufe t2b;
-		ecpt q, s;
+	ec_set(EC_G, q);
 
-		ec_set(EC_G, q);
-
-		for (int ii = 0; ii < (w - 1); ++ii) {
-			if (u & (1 << ii)) {
-				ec_set(EC_G, s);
-				for (int jj = 0; jj < (d * (ii + 1)); ++jj) {
-					ec_add(s, s, s, false, true, true, t2b);
-				}
-				ec_add(q, s, q, false, true, true, t2b);
-			}
+	for (int ii = 0; ii < 64; ++ii) {
+		// q = (2 * ii + 1) * G
+		if (ii > 0) {
+			ec_add(q, g2, q, true, true, true, t2b);
 		}
 
-		// Get affine version
-		ecpt_affine qa;
+		ecpt_affine qa, ea;
 		ec_affine(q, qa);
+		ec_expand(qa, q);
+
+		table[0][ii].x = qa.x;
+		table[0][ii].y = qa.y;
+		fe_mul(qa.x, qa.y, table[0][ii].t);
 
-		// Store in table entry without Z=1
-		table[u].x = qa.x;
-		table[u].y = qa.y;
-		fe_mul(qa.x, qa.y, table[u].t);
+		// Same for endomorphism(G)
+		gls_morph(qa.x, qa.y, ea.x, ea.y);
+		fe_complete_reduce(ea.x);
+		fe_complete_reduce(ea.y);
+
+		table[1][ii].x = ea.x;
+		table[1][ii].y = ea.y;
+		fe_mul(ea.x, ea.y, table[1][ii].t);
 	}
 
 #if 0
 
-	ecpt_z1 *ptr = table;
-	cout << "static const u64 PRECOMP_TABLE_3[12*128] = {" << endl;
-	for (int ii = 0; ii < 128; ++ii) {
-		cout << "0x" << hex << ptr->x.a.i[0] << "ULL, 0x" << ptr->x.a.i[1] << "ULL, 0x" << ptr->x.b.i[0] << "ULL, 0x" << ptr->x.b.i[1] << "ULL," << endl;
-		cout << "0x" << hex << ptr->y.a.i[0] << "ULL, 0x" << ptr->y.a.i[1] << "ULL, 0x" << ptr->y.b.i[0] << "ULL, 0x" << ptr->y.b.i[1] << "ULL," << endl;
-		cout << "0x" << hex << ptr->t.a.i[0] << "ULL, 0x" << ptr->t.a.i[1] << "ULL, 0x" << ptr->t.b.i[0] << "ULL, 0x" << ptr->t.b.i[1] << "ULL," << endl;
-		ptr++;
+	cout << "static const u64 PRECOMP_TABLE_6[2][12 * 64] = {{" << endl;
+	for (int jj = 0; jj < 2; ++jj) {
+		ecpt_z1 *ptr = table[jj];
+		for (int ii = 0; ii < 64; ++ii) {
+			cout << "0x" << hex << ptr->x.a.i[0] << "ULL, 0x" << ptr->x.a.i[1] << "ULL, 0x" << ptr->x.b.i[0] << "ULL, 0x" << ptr->x.b.i[1] << "ULL," << endl;
+			cout << "0x" << hex << ptr->y.a.i[0] << "ULL, 0x" << ptr->y.a.i[1] << "ULL, 0x" << ptr->y.b.i[0] << "ULL, 0x" << ptr->y.b.i[1] << "ULL," << endl;
+			cout << "0x" << hex << ptr->t.a.i[0] << "ULL, 0x" << ptr->t.a.i[1] << "ULL, 0x" << ptr->t.b.i[0] << "ULL, 0x" << ptr->t.b.i[1] << "ULL," << endl;
+			ptr++;
+		}
+		cout << (jj == 0 ? "}, {" : "}};") << endl;
 	}
-	cout << "};" << endl;
 
 #endif
 
-	if (0 != memcmp(table, SIMUL_GEN_TABLE, sizeof(table))) {
-		return false;
+	for (int jj = 0; jj < 2; ++jj) {
+		if (0 != memcmp(table[jj], WNAF_GEN_TABLE[jj], sizeof(table[jj]))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Verify runtime-built generator multiplication tables are consistent
+static bool ec_gen_tables_large_test(ecpt_affine *gen, ecpt_z1 *wnaf) {
+	double s0 = m_clock.usec();
+
+	ec_gen_tables_large(gen, wnaf);
+
+	double s1 = m_clock.usec();
+
+	cout << "+ ec_gen_tables_large: `" << dec << (s1 - s0) << "` usec" << endl;
+
+	// Every e-th row should match one of the built-in subtables
+	for (int vp = 0; vp < MG_v; ++vp) {
+		if (0 != memcmp(gen + vp * MG_e * MG_width, GEN_TABLE[vp], MG_width * sizeof(ecpt_affine))) {
+			return false;
+		}
+	}
+
+	// The wNAF tables should start with the built-in ones
+	for (int jj = 0; jj < 2; ++jj) {
+		if (0 != memcmp(wnaf + jj * WNAF_GEN_LARGE_WIDTH, WNAF_GEN_TABLE[jj], 64 * sizeof(ecpt_z1))) {
+			return false;
+		}
 	}
 
 	return true;
@@ -691,7 +722,358 @@ bool ec_simul_test(const ecpt_affine &B1, const ecpt_affine &B2) {
 	return true;
 }
 
-bool ec_simul_gen_test(const ecpt_affine &BP) {
+static u64 m_fixed_base[(sizeof(ec_fixed_base) + MG_d * MG_width * sizeof(ecpt_affine)) / 8] CAT_ALIGNED(64);
+
+bool ec_fixed_base_test(const ecpt_affine &BP, const int v) {
+	u64 k1[4], k2[4];
+	ecpt_affine R1, R2;
+	u8 a1[64], a2[64];
+
+	ec_fixed_base *fb = (ec_fixed_base *)m_fixed_base;
+	ec_gen_fixed_base(BP, v, fb);
+
+	vector<u32> t, ts, tc;
+	double wall = 0, walls = 0, wallc = 0;
+
+	for (int jj = 0; jj < 1000; ++jj) {
+		random_k(k1);
+		random_k(k2);
+		ec_mask_scalar(k1);
+		ec_mask_scalar(k2);
+
+		// R = 4kP
+
+		ec_mul_ref(k2, BP, R1);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		ec_mul_fixed_base_affine(k2, fb, R2);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		t.push_back(t1 - t0);
+		wall += s1 - s0;
+
+		ec_save_xy(R1, a1);
+		ec_save_xy(R2, a2);
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (a1[ii] != a2[ii]) {
+				return false;
+			}
+		}
+
+		// R = 4aG + 4bP
+
+		if (jj == 0) {
+			k1[0] = EC_Q[0];
+			k1[1] = EC_Q[1];
+			k1[2] = EC_Q[2];
+			k1[3] = EC_Q[3];
+		}
+
+		ec_simul_ref(k1, EC_G_AFFINE, k2, BP, R1);
+
+		if (jj == 0) {
+			k1[0] = 0;
+			k1[1] = 0;
+			k1[2] = 0;
+			k1[3] = 0;
+		}
+
+		s0 = m_clock.usec();
+		t0 = Clock::cycles();
+
+		ec_simul_gen_fixed_base_affine(k1, k2, fb, false, R2);
+
+		t1 = Clock::cycles();
+		s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		walls += s1 - s0;
+
+		ec_save_xy(R1, a1);
+		ec_save_xy(R2, a2);
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (a1[ii] != a2[ii]) {
+				return false;
+			}
+		}
+
+		// Constant-time version for commitments
+
+		s0 = m_clock.usec();
+		t0 = Clock::cycles();
+
+		ec_simul_gen_fixed_base_affine(k1, k2, fb, true, R2);
+
+		t1 = Clock::cycles();
+		s1 = m_clock.usec();
+
+		tc.push_back(t1 - t0);
+		wallc += s1 - s0;
+
+		ec_save_xy(R2, a2);
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (a1[ii] != a2[ii]) {
+				return false;
+			}
+		}
+	}
+
+	u32 median = quick_select(&t[0], (int)t.size());
+	wall /= t.size();
+	u32 medians = quick_select(&ts[0], (int)ts.size());
+	walls /= ts.size();
+	u32 medianc = quick_select(&tc[0], (int)tc.size());
+	wallc /= tc.size();
+
+	cout << "+ ec_mul_fixed_base(v=" << dec << v << "): `" << median << "` median cycles, `" << wall << "` avg usec" << endl;
+	cout << "+ ec_simul_gen_fixed_base(v=" << dec << v << "): `" << medians << "` median cycles, `" << walls << "` avg usec" << endl;
+	cout << "+ ec_simul_gen_fixed_base(v=" << dec << v << ", constant time): `" << medianc << "` median cycles, `" << wallc << "` avg usec" << endl;
+
+	return true;
+}
+
+bool ec_mul_table_test(const ecpt_affine &BP) {
+	u64 k[4];
+	ecpt_affine R1, R2;
+	u8 a1[64], a2[64];
+
+	ec_point_table T;
+	ec_gen_point_table(BP, T);
+
+	vector<u32> t;
+	double wall = 0;
+
+	for (int jj = 0; jj < 10000; ++jj) {
+		random_k(k);
+		ec_mask_scalar(k);
+
+		ec_mul_ref(k, BP, R1);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		ec_mul_table_affine(k, T, R2);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		t.push_back(t1 - t0);
+		wall += s1 - s0;
+
+		ec_save_xy(R1, a1);
+		ec_save_xy(R2, a2);
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (a1[ii] != a2[ii]) {
+				return false;
+			}
+		}
+	}
+
+	u32 median = quick_select(&t[0], (int)t.size());
+	wall /= t.size();
+
+	cout << "+ ec_mul_table: `" << dec << median << "` median cycles, `" << wall << "` avg usec" << endl;
+
+	return true;
+}
+
+bool ec_handles_test(const ecpt_affine &B1, const ecpt_affine &B2) {
+	// Enough points for ec_affine_handles() to take a partial second chunk
+	const int n = EC_MUL_MANY_CHUNK + 3;
+
+	u64 k1[4], k2[4];
+	ecpt P, Q, H[n];
+	ecpt_affine R1[n], R2[n];
+	u8 a1[64], a2[64];
+
+	vector<u32> t;
+	double wall = 0;
+
+	ec_expand(B1, P);
+	ec_expand(B2, Q);
+
+	for (int jj = 0; jj < 1000; ++jj) {
+		random_k(k1);
+		random_k(k2);
+		ec_mask_scalar(k1);
+		ec_mask_scalar(k2);
+
+		// R1 = 4k1*B1, 4k1*B1 + 4k2*B2, their sum, then doublings
+		ec_mul_ref(k1, B1, R1[0]);
+		ec_simul_ref(k1, B1, k2, B2, R1[1]);
+
+		ufe t2b;
+		ecpt X, Y;
+		ec_expand(R1[0], X);
+		ec_expand(R1[1], Y);
+		ec_add(X, Y, X, true, true, false, t2b);
+		ec_affine(X, R1[2]);
+
+		for (int ii = 3; ii < n; ++ii) {
+			ec_dbl(X, X, false, t2b);
+			ec_affine(X, R1[ii]);
+		}
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		ec_mul_handle(k1, P, H[0]);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		t.push_back(t1 - t0);
+		wall += s1 - s0;
+
+		ec_simul_handle(k1, P, k2, Q, H[1]);
+		ec_add_handle(H[0], H[1], H[2]);
+
+		for (int ii = 3; ii < n; ++ii) {
+			ec_dbl_handle(H[ii - 1], H[ii]);
+		}
+
+		ec_affine_handles(H, n, R2);
+
+		for (int ii = 0; ii < n; ++ii) {
+			ec_save_xy(R1[ii], a1);
+			ec_save_xy(R2[ii], a2);
+
+			for (int kk = 0; kk < 64; ++kk) {
+				if (a1[kk] != a2[kk]) {
+					return false;
+				}
+			}
+		}
+	}
+
+	u32 median = quick_select(&t[0], (int)t.size());
+	wall /= t.size();
+
+	cout << "+ ec_mul_handle: `" << dec << median << "` median cycles, `" << wall << "` avg usec" << endl;
+
+	return true;
+}
+
+bool ec_mul_many_test(const int n) {
+	u64 k[4];
+	ecpt_affine P[40], R[40], R1;
+	u8 a1[64], a2[64];
+
+	vector<u32> t;
+	double wall = 0;
+
+	for (int jj = 0; jj < 100; ++jj) {
+		random_k(k);
+		ec_mask_scalar(k);
+
+		for (int ii = 0; ii < n; ++ii) {
+			u64 kp[4];
+			random_k(kp);
+			ec_mask_scalar(kp);
+			ec_mul_ref(kp, EC_G_AFFINE, P[ii]);
+		}
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		ec_mul_many_affine(k, P, n, R);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		t.push_back((t1 - t0) / n);
+		wall += (s1 - s0) / n;
+
+		for (int ii = 0; ii < n; ++ii) {
+			ec_mul_ref(k, P[ii], R1);
+
+			ec_save_xy(R1, a1);
+			ec_save_xy(R[ii], a2);
+
+			for (int kk = 0; kk < 64; ++kk) {
+				if (a1[kk] != a2[kk]) {
+					return false;
+				}
+			}
+		}
+	}
+
+	u32 median = quick_select(&t[0], (int)t.size());
+	wall /= t.size();
+
+	cout << "+ ec_mul_many(" << dec << n << ") per point: `" << median << "` median cycles, `" << wall << "` avg usec" << endl;
+
+	return true;
+}
+
+bool ec_simul_n_test(const ecpt_affine B[], const int n) {
+	u64 k[EC_SIMUL_N_MAX][4];
+	ecpt_affine R1, R2;
+	u8 a1[64], a2[64];
+
+	vector<u32> t;
+	double wall = 0;
+
+	for (int jj = 0; jj < 1000; ++jj) {
+		ecpt sum;
+		ufe t2b;
+
+		for (int ii = 0; ii < n; ++ii) {
+			random_k(k[ii]);
+			ec_mask_scalar(k[ii]);
+
+			ecpt_affine Rr;
+			ec_mul_ref(k[ii], B[ii], Rr);
+
+			if (ii == 0) {
+				ec_expand(Rr, sum);
+			} else {
+				ecpt Re;
+				ec_expand(Rr, Re);
+				ec_add(sum, Re, sum, true, true, true, t2b);
+			}
+		}
+
+		ec_affine(sum, R1);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		ec_simul_n_affine(k, B, n, R2);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		t.push_back(t1 - t0);
+		wall += s1 - s0;
+
+		ec_save_xy(R1, a1);
+		ec_save_xy(R2, a2);
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (a1[ii] != a2[ii]) {
+				return false;
+			}
+		}
+	}
+
+	u32 median = quick_select(&t[0], (int)t.size());
+	wall /= t.size();
+
+	cout << "+ ec_simul_n(" << dec << n << "): `" << median << "` median cycles, `" << wall << "` avg usec" << endl;
+
+	return true;
+}
+
+bool ec_simul_gen_wnaf_test(const ecpt_affine &BP) {
 	u64 k1[4] = {0};
 	u64 k2[4] = {0};
 	ecpt_affine R1, R2;
@@ -725,7 +1107,7 @@ bool ec_simul_gen_test(const ecpt_affine &BP) {
 		double s0 = m_clock.usec();
 		u32 t0 = Clock::cycles();
 
-		ec_simul_gen_affine(k1, k2, BP, R2);
+		ec_simul_gen_wnaf_affine(k1, k2, BP, R2);
 
 		u32 t1 = Clock::cycles();
 		double s1 = m_clock.usec();
@@ -747,7 +1129,7 @@ bool ec_simul_gen_test(const ecpt_affine &BP) {
 	u32 median = quick_select(&t[0], (int)t.size());
 	wall /= t.size();
 
-	cout << "+ ec_simul_gen: `" << dec << median << "` median cycles, `" << wall << "` avg usec" << endl;
+	cout << "+ ec_simul_gen_wnaf: `" << dec << median << "` median cycles, `" << wall << "` avg usec" << endl;
 
 	return true;
 }
@@ -912,6 +1294,10 @@ int main() {
 	cout << "Using vector extensions for table lookups! <3" << endl;
 #endif
 
+#ifdef CAT_SNOWSHOE_AVX2
+	cout << "Using AVX2 for table lookups" << endl;
+#endif
+
 	srand(0);
 
 	m_clock.OnInitialize();
@@ -919,7 +1305,7 @@ int main() {
 	tscTime();
 
 	// Verify tables have not been tampered with
-	assert(ec_gen_tables3_comb_test());
+	assert(ec_gen_tables_wnaf_test());
 	assert(ec_gen_tables_comb_test());
 
 	assert(mod_q_test());
@@ -953,9 +1339,27 @@ int main() {
 	assert(ec_elligator_test());
 	assert(ec_mul_gen_test());
 	assert(ec_mul_test(bp1));
-	assert(ec_simul_gen_test(bp1));
+	assert(ec_simul_gen_wnaf_test(bp1));
 	assert(ec_simul_test(bp1, bp2));
 
+	u64 bk3[4] = {0}, bk4[4] = {0};
+	ecpt_affine bpn[EC_SIMUL_N_MAX];
+	random_k(bk3);
+	random_k(bk4);
+	bpn[0] = bp1;
+	bpn[1] = bp2;
+	ec_mul_ref(bk3, EC_G_AFFINE, bpn[2]);
+	ec_mul_ref(bk4, EC_G_AFFINE, bpn[3]);
+	assert(ec_simul_n_test(bpn, 3));
+	assert(ec_simul_n_test(bpn, 4));
+	assert(ec_mul_table_test(bp1));
+	assert(ec_mul_table_test(bp2));
+	assert(ec_mul_many_test(1));
+	assert(ec_mul_many_test(40));
+	assert(ec_handles_test(bp1, bp2));
+	assert(ec_fixed_base_test(bp1, MG_v));
+	assert(ec_fixed_base_test(bp2, MG_d));
+
 	cout << "Extra tests with exceptional points:" << endl;
 
 	// Extra tests:
@@ -963,7 +1367,24 @@ int main() {
 	assert(ec_simul_test(EC_O_AFFINE, bp1));
 	assert(ec_mul_test(bp2));
 	assert(ec_mul_test(EC_O_AFFINE));
-	assert(ec_simul_gen_test(EC_O_AFFINE));
+	assert(ec_simul_gen_wnaf_test(EC_O_AFFINE));
+
+	cout << "Tests with runtime-built tables:" << endl;
+
+	ecpt_affine *gen_large = new ecpt_affine[MG_d * MG_width];
+	ecpt_z1 *wnaf_large = new ecpt_z1[2 * WNAF_GEN_LARGE_WIDTH];
+	assert(ec_gen_tables_large_test(gen_large, wnaf_large));
+
+	ec_use_tables_large(gen_large, wnaf_large);
+	assert(ec_mul_gen_test());
+	assert(ec_fixed_base_test(bp1, MG_v));
+	assert(ec_fixed_base_test(bp2, MG_d));
+	assert(ec_simul_gen_wnaf_test(bp1));
+	assert(ec_simul_gen_wnaf_test(EC_O_AFFINE));
+	ec_use_tables_large(0, 0);
+
+	delete []wnaf_large;
+	delete []gen_large;
 
 	cout << "All tests passed successfully." << endl;
 
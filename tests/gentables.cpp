@@ -0,0 +1,106 @@
+#include <iostream>
+#include <cstdlib>
+using namespace std;
+
+// Math library
+#include "../src/ecpt.inc"
+
+/*
+ * Generator comb table generator
+ *
+ * Prints the PRECOMP_TABLE_0 and PRECOMP_TABLE_2 tables used by ec_mul_gen
+ * for the LSB-set comb parameters w,v given on the command line.
+ *
+ * Usage: ./gentables <w> <v> > src/precomp_mg.inc
+ *
+ * Then build with -DCAT_SNOWSHOE_MG_W=<w> -DCAT_SNOWSHOE_MG_V=<v>.
+ * The ecmul unit tester verifies the tables for the selected parameters.
+ */
+
+static void print_fe(const ufe &x, bool comma) {
+	cout << "0x" << hex << x.a.i[0] << "ULL, 0x" << x.a.i[1] << "ULL, 0x" << x.b.i[0] << "ULL, 0x" << x.b.i[1] << "ULL";
+	cout << (comma ? "," : "") << endl;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		cerr << "Usage: " << argv[0] << " <w> <v>" << endl;
+		return 1;
+	}
+
+	const int t = 252;
+	const int w = atoi(argv[1]);
+	const int v = atoi(argv[2]);
+	const int e = (t + w*v - 1) / (w * v); // = ceil(t/wv)
+	const int d = e * v;
+	const int l = d * w;
+	const int width = 1 << (w - 1);
+
+	if (w < 2 || v < 1 || d > 64) {
+		cerr << "Unsupported parameters: need w >= 2, v >= 1, d = e * v <= 64" << endl;
+		return 1;
+	}
+
+	cout << "// Generated by gentables for w=" << dec << w << ", v=" << v;
+	cout << " (e=" << e << ", d=" << d << ", table bytes=" << v * width * 64 << ")" << endl;
+	cout << endl;
+
+	ufe t2b;
+	ecpt s;
+
+	// PRECOMP_TABLE_2 = 2^l * G, used to correct the carry out of the recoding
+
+	ec_set(EC_G, s);
+	for (int jj = 0; jj < l; ++jj) {
+		ec_dbl(s, s, false, t2b);
+	}
+	ecpt_affine fix;
+	ec_affine(s, fix);
+	ec_expand(fix, s);
+
+	cout << "static const u64 PRECOMP_TABLE_2[4 * 4] CAT_ALIGNED(64) = {" << endl;
+	print_fe(s.x, true);
+	print_fe(s.y, true);
+	print_fe(s.t, true);
+	print_fe(s.z, true);
+	cout << "};" << endl;
+	cout << endl;
+
+	// PRECOMP_TABLE_0[v'][u] = 2^(ev') * (1 + u0*2^d + ... + u_(w-2)*2^((w-1)*d)) * G
+
+	cout << dec << "static const u64 PRECOMP_TABLE_0[" << v << "][8 * " << width << "] CAT_ALIGNED(64) = {";
+	for (int vp = 0; vp < v; ++vp) {
+		cout << "{" << endl;
+
+		for (int u = 0; u < width; ++u) {
+			ecpt q;
+
+			ec_set(EC_G, q);
+
+			for (int ii = 0; ii < (w - 1); ++ii) {
+				if (u & (1 << ii)) {
+					ec_set(EC_G, s);
+					for (int jj = 0; jj < (d * (ii + 1)); ++jj) {
+						ec_add(s, s, s, false, true, true, t2b);
+					}
+					ec_add(q, s, q, false, true, true, t2b);
+				}
+			}
+
+			for (int ii = 0; ii < e * vp; ++ii) {
+				ec_dbl(q, q, false, t2b);
+			}
+
+			ecpt_affine entry;
+			ec_affine(q, entry);
+
+			print_fe(entry.x, true);
+			print_fe(entry.y, u + 1 < width);
+		}
+
+		cout << "}" << (vp + 1 < v ? "," : "");
+	}
+	cout << "};" << endl;
+
+	return 0;
+}
@@ -3,11 +3,17 @@
 #include <cassert>
 #include <vector>
 #include <cstdlib>
+#include <cstring>
+#include <cstdio>
 using namespace std;
 
 #include "Clock.hpp"
 using namespace cat;
 
+#if !defined(CAT_OS_WINDOWS)
+#include <poll.h>
+#endif
+
 // Math library
 #include "snowshoe.h"
 
@@ -195,9 +201,10 @@ bool ec_dh_fs_test() {
 	char sk_c[32], sk_s[32], sk_e[32];
 	char pp_c[64], pp_s[64], pp_e[64];
 	char sp_c[64], sp_s[64];
+	char pp_e1[64], sp_s1[64], sp_c1[64];
 
-	vector<u32> tc, ts, tc1;
-	double wc = 0, ws = 0, wc1 = 0;
+	vector<u32> tc, ts, tc1, ts2, tc2;
+	double wc = 0, ws = 0, wc1 = 0, ws2 = 0, wc2 = 0;
 
 	for (int iteration = 0; iteration < 10000; ++iteration) {
 		// Offline: Server long-term public key generation
@@ -281,6 +288,50 @@ bool ec_dh_fs_test() {
 				return false;
 			}
 		}
+
+		// One-shot server: pp_e and sp in one call
+
+		s0 = m_clock.usec();
+		t0 = Clock::cycles();
+
+		if (snowshoe_dhfs_server(sk_s, sk_e, h, pp_c, pp_e1, sp_s1)) {
+			cout << "ec_dh_fs: snowshoe_dhfs_server failed at " << iteration << endl;
+			return false;
+		}
+
+		t1 = Clock::cycles();
+		s1 = m_clock.usec();
+
+		ts2.push_back(t1 - t0);
+		ws2 += s1 - s0;
+
+		// One-shot client
+
+		s0 = m_clock.usec();
+		t0 = Clock::cycles();
+
+		if (snowshoe_dhfs_client(sk_c, h, pp_e1, pp_s, sp_c1)) {
+			cout << "ec_dh_fs: snowshoe_dhfs_client failed at " << iteration << endl;
+			return false;
+		}
+
+		t1 = Clock::cycles();
+		s1 = m_clock.usec();
+
+		tc2.push_back(t1 - t0);
+		wc2 += s1 - s0;
+
+		if (memcmp(pp_e1, pp_e, 64) != 0 || memcmp(sp_s1, sp_s, 64) != 0 || memcmp(sp_c1, sp_s, 64) != 0) {
+			cout << "ec_dh_fs: one-shot mismatch at " << iteration << endl;
+			return false;
+		}
+	}
+
+	// Invalid client point is rejected
+	memset(pp_c, 0, 64);
+	if (!snowshoe_dhfs_server(sk_s, sk_e, h, pp_c, pp_e1, sp_s1)) {
+		cout << "ec_dh_fs: snowshoe_dhfs_server accepted an invalid point" << endl;
+		return false;
 	}
 
 	u32 mc = quick_select(&tc[0], (int)tc.size());
@@ -290,9 +341,16 @@ bool ec_dh_fs_test() {
 	u32 ms = quick_select(&ts[0], (int)ts.size());
 	ws /= ts.size();
 
+	u32 ms2 = quick_select(&ts2[0], (int)ts2.size());
+	ws2 /= ts2.size();
+	u32 mc2 = quick_select(&tc2[0], (int)tc2.size());
+	wc2 /= tc2.size();
+
 	cout << "+ EC-DH-FS client gen: `" << dec << mc << "` median cycles, `" << wc << "` avg usec" << endl;
 	cout << "+ EC-DH-FS server proc: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
 	cout << "+ EC-DH-FS client proc: `" << dec << mc1 << "` median cycles, `" << wc1 << "` avg usec" << endl;
+	cout << "+ EC-DH-FS server one-shot: `" << dec << ms2 << "` median cycles, `" << ws2 << "` avg usec" << endl;
+	cout << "+ EC-DH-FS client one-shot: `" << dec << mc2 << "` median cycles, `" << wc2 << "` avg usec" << endl;
 
 	return true;
 }
@@ -495,52 +553,1954 @@ static bool ec_elligator_test() {
 }
 
 
-//// Entrypoint
+/*
+ * EdDSA sign/verify API:
+ *
+ * Validate that signatures verify for messages around the hash block size
+ * Validate that changing the message, signature or public key fails
+ * Validate that signing is deterministic
+ */
 
-static void tscTime() {
-	const u32 c0 = Clock::cycles();
-	const double t0 = m_clock.usec();
-	const double t_end = t0 + 1000000.0;
+static bool ec_sign_test() {
+	static const int LENGTHS[] = {0, 1, 127, 128, 129, 256, 4096};
+	static const int COUNT = sizeof(LENGTHS) / sizeof(LENGTHS[0]);
 
-	double t;
-	u32 c;
-	do {
-		c = Clock::cycles();
-		t = m_clock.usec();
-	} while (t < t_end);
+	vector<char> msg(4096);
+	for (int ii = 0; ii < (int)msg.size(); ++ii) {
+		msg[ii] = (char)(ii * 7);
+	}
 
-	cout << "RDTSC instruction runs at " << (c - c0)/(t - t0)/1000.0 << " GHz" << endl;
+	vector<u32> ts, tv;
+	double ws = 0, wv = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char seed[32], sk[64], pk[64], pk2[64], sig[96], sig2[96];
+
+		generate_k(seed);
+		if (snowshoe_sign_keygen(seed, sk, pk)) {
+			cout << "sign: snowshoe_sign_keygen failed at " << iteration << endl;
+			return false;
+		}
+
+		// A = a*G
+		if (snowshoe_mul_gen(sk, pk2, 0) || memcmp(pk, pk2, 64) != 0) {
+			cout << "sign: public key mismatch at " << iteration << endl;
+			return false;
+		}
+
+		const int bytes = LENGTHS[iteration % COUNT];
+		msg[iteration % msg.size()] ^= 1;
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_sign(sk, pk, &msg[0], bytes, sig)) {
+			cout << "sign: snowshoe_sign failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		if (snowshoe_verify(pk, &msg[0], bytes, sig)) {
+			cout << "sign: snowshoe_verify failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t2 = Clock::cycles();
+		double s2 = m_clock.usec();
+
+		if (bytes == 4096) {
+			ts.push_back(t1 - t0);
+			ws += s1 - s0;
+			tv.push_back(t2 - t1);
+			wv += s2 - s1;
+		}
+
+		// Deterministic
+		if (snowshoe_sign(sk, pk, &msg[0], bytes, sig2) || memcmp(sig, sig2, 96) != 0) {
+			cout << "sign: signature is not deterministic at " << iteration << endl;
+			return false;
+		}
+
+		// Changed message
+		if (bytes > 0) {
+			msg[bytes - 1] ^= 0x10;
+			const bool accepted = !snowshoe_verify(pk, &msg[0], bytes, sig);
+			msg[bytes - 1] ^= 0x10;
+			if (accepted) {
+				cout << "sign: changed message accepted at " << iteration << endl;
+				return false;
+			}
+		}
+
+		// Changed signature
+		sig2[iteration % 96] ^= 0x04;
+		if (!snowshoe_verify(pk, &msg[0], bytes, sig2)) {
+			cout << "sign: changed signature accepted at " << iteration << endl;
+			return false;
+		}
+
+		// Other public key
+		generate_k(seed);
+		if (snowshoe_sign_keygen(seed, sk, pk2)) {
+			return false;
+		}
+		if (!snowshoe_verify(pk2, &msg[0], bytes, sig)) {
+			cout << "sign: other public key accepted at " << iteration << endl;
+			return false;
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+	u32 mv = quick_select(&tv[0], (int)tv.size());
+	wv /= tv.size();
+
+	cout << "+ snowshoe_sign (4 KB): `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+	cout << "+ snowshoe_verify (4 KB): `" << dec << mv << "` median cycles, `" << wv << "` avg usec" << endl;
+
+	return true;
 }
 
-int main() {
-	cout << "Snowshoe Unit Tester" << endl;
+/*
+ * Scatter/gather and prehashed EdDSA:
+ *
+ * Validate that splitting the message over buffers gives the same signature
+ * Validate that hashing the message in chunks gives the same signature
+ * Validate that prehashed and plain signatures do not verify as each other
+ */
 
-#ifdef CAT_SNOWSHOE_VECTOR_OPT
-	cout << "Using vector extensions for table lookups! <3" << endl;
-#endif
+static bool ec_sign_stream_test() {
+	vector<char> msg(4096);
+	for (int ii = 0; ii < (int)msg.size(); ++ii) {
+		msg[ii] = (char)(ii * 13);
+	}
 
-	// Note that assert() should not be used for crypto code since it is often compiled
-	// out in release mode.  It is only used here for testing.
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char seed[32], sk[64], pk[64], sig[96], sig2[96];
 
-	m_clock.OnInitialize();
+		generate_k(seed);
+		if (snowshoe_sign_keygen(seed, sk, pk)) {
+			return false;
+		}
 
-	tscTime();
+		const int bytes = (iteration * 37) % (int)msg.size();
+		msg[iteration % msg.size()] ^= 1;
+
+		// Split the message at two points
+		const int cut0 = bytes ? (iteration % bytes) : 0;
+		const int cut1 = cut0 + (bytes - cut0) / 2;
+
+		snowshoe_iovec iov[3];
+		iov[0].data = &msg[0];
+		iov[0].bytes = cut0;
+		iov[1].data = &msg[cut0];
+		iov[1].bytes = cut1 - cut0;
+		iov[2].data = &msg[cut1];
+		iov[2].bytes = bytes - cut1;
+
+		if (snowshoe_sign(sk, pk, &msg[0], bytes, sig) ||
+			snowshoe_sign_iov(sk, pk, iov, 3, sig2) ||
+			memcmp(sig, sig2, 96) != 0) {
+			cout << "sign_stream: iov signature mismatch at " << iteration << endl;
+			return false;
+		}
 
-	srand(0);
+		if (snowshoe_verify_iov(pk, iov, 3, sig)) {
+			cout << "sign_stream: snowshoe_verify_iov failed at " << iteration << endl;
+			return false;
+		}
 
-	// Example of verifying API level on startup:
+		// Hash the whole message at once, then in chunks
+		snowshoe_prehash ph;
+		snowshoe_prehash_init(&ph);
+		snowshoe_prehash_update(&ph, &msg[0], bytes);
+		if (snowshoe_sign_prehash(sk, pk, &ph, sig2)) {
+			cout << "sign_stream: snowshoe_sign_prehash failed at " << iteration << endl;
+			return false;
+		}
 
-	double t0 = m_clock.usec();
-	if (snowshoe_init()) {
-		throw "Wrong snowshoe static library is linked";
+		const int chunk = 1 + iteration % 200;
+		snowshoe_prehash_init(&ph);
+		for (int off = 0; off < bytes; off += chunk) {
+			snowshoe_prehash_update(&ph, &msg[off], (bytes - off < chunk) ? (bytes - off) : chunk);
+		}
+		if (snowshoe_verify_prehash(pk, &ph, sig2)) {
+			cout << "sign_stream: snowshoe_verify_prehash failed at " << iteration << endl;
+			return false;
+		}
+
+		// Plain and prehashed signatures are distinct
+		if (memcmp(sig, sig2, 96) == 0 || !snowshoe_verify(pk, &msg[0], bytes, sig2)) {
+			cout << "sign_stream: prehashed signature accepted as plain at " << iteration << endl;
+			return false;
+		}
+
+		snowshoe_prehash_init(&ph);
+		snowshoe_prehash_update(&ph, &msg[0], bytes);
+		if (!snowshoe_verify_prehash(pk, &ph, sig)) {
+			cout << "sign_stream: plain signature accepted as prehashed at " << iteration << endl;
+			return false;
+		}
+
+		// Changed message
+		if (bytes > 0) {
+			snowshoe_prehash_init(&ph);
+			snowshoe_prehash_update(&ph, &msg[0], bytes - 1);
+			if (!snowshoe_verify_prehash(pk, &ph, sig2)) {
+				cout << "sign_stream: truncated message accepted at " << iteration << endl;
+				return false;
+			}
+		}
 	}
-	double t1 = m_clock.usec();
-	cout << "snowshoe_init() ran in " << (t1 - t0) << " usec" << endl;
 
-	assert(ec_elligator_test());
-	assert(ec_dh_test());
-	assert(ec_dh_fs_test());
+	return true;
+}
+
+/*
+ * Simultaneous multiplication of n points:
+ *
+ * P[i] = x[i] * G
+ * c = k[0] * x[0] + ... + k[n-1] * x[n-1] (mod q)
+ *
+ * Validate snowshoe_simul_n(k, P) == c * 4 * G
+ */
+
+static bool ec_simul_n_test(const int n) {
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char k[4][32], x[32], P[4][64], c[32] = {0};
+
+		for (int ii = 0; ii < n; ++ii) {
+			generate_k(k[ii]);
+			snowshoe_secret_gen(k[ii]);
+
+			generate_k(x);
+			snowshoe_secret_gen(x);
+
+			if (snowshoe_mul_gen(x, P[ii], 0)) {
+				cout << "simul_n: snowshoe_mul_gen failed at " << iteration << endl;
+				return false;
+			}
+
+			// c += k * x (mod q)
+			char t[32];
+			snowshoe_mul_mod_q(k[ii], x, c, t);
+			memcpy(c, t, 32);
+		}
+
+		char R1[64], R2[64];
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_simul_n(k, P, n, R1)) {
+			cout << "simul_n: snowshoe_simul_n failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_mul_gen(c, R2, 1)) {
+			cout << "simul_n: snowshoe_mul_gen(c) failed at " << iteration << endl;
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "simul_n: result mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Simul " << n << " points: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+
+/*
+ * Many scalars against one point:
+ *
+ * Validate snowshoe_mul_with_table(k, table(P)) == snowshoe_mul(k, P)
+ */
+
+static bool ec_point_table_test() {
+	char x[32], P[64];
+
+	// Align table memory to 64 bytes
+	vector<char> mem(sizeof(snowshoe_point_table) + 63);
+	snowshoe_point_table *table = (snowshoe_point_table *)&mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+
+	generate_k(x);
+	snowshoe_secret_gen(x);
+	if (snowshoe_mul_gen(x, P, 0)) {
+		return false;
+	}
+
+	if (0 == snowshoe_point_table_init(P, (snowshoe_point_table *)((char *)table + 8))) {
+		cout << "point_table: snowshoe_point_table_init accepted misaligned memory" << endl;
+		return false;
+	}
+
+	if (snowshoe_point_table_init(P, table)) {
+		cout << "point_table: snowshoe_point_table_init failed" << endl;
+		return false;
+	}
+
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 10000; ++iteration) {
+		char k[32], R1[64], R2[64];
+
+		generate_k(k);
+		snowshoe_secret_gen(k);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_mul_with_table(k, table, R1)) {
+			cout << "point_table: snowshoe_mul_with_table failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_mul(k, P, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "point_table: result mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Mul with point table: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Fixed-base comb table for a long-lived point:
+ *
+ * Validate snowshoe_fixed_base_mul(k, table(P)) == snowshoe_mul(k, P)
+ * Validate snowshoe_fixed_base_simul_gen(a, b, table(P)) == snowshoe_simul_gen(a, b, P)
+ */
+
+static bool ec_fixed_base_test(int size_class) {
+	char x[32], P[64];
+
+	generate_k(x);
+	snowshoe_secret_gen(x);
+	if (snowshoe_mul_gen(x, P, 0)) {
+		return false;
+	}
+
+	// Align table memory to 64 bytes
+	const int bytes = snowshoe_fixed_base_bytes(size_class);
+	vector<char> mem(bytes + 63);
+	void *table = &mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+
+	if (snowshoe_fixed_base_create(P, size_class, table)) {
+		cout << "fixed_base: snowshoe_fixed_base_create failed" << endl;
+		return false;
+	}
+
+	vector<u32> tm, ts;
+	double wm = 0, ws = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char a[32], b[32], R1[64], R2[64];
+
+		generate_k(a);
+		snowshoe_secret_gen(a);
+		generate_k(b);
+		snowshoe_secret_gen(b);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_fixed_base_mul(b, table, R1)) {
+			cout << "fixed_base: snowshoe_fixed_base_mul failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		tm.push_back(t1 - t0);
+		wm += s1 - s0;
+
+		if (snowshoe_mul(b, P, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "fixed_base: mul mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+
+		s0 = m_clock.usec();
+		t0 = Clock::cycles();
+
+		if (snowshoe_fixed_base_simul_gen(a, b, table, R1)) {
+			cout << "fixed_base: snowshoe_fixed_base_simul_gen failed at " << iteration << endl;
+			return false;
+		}
+
+		t1 = Clock::cycles();
+		s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_simul_gen(a, b, P, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "fixed_base: simul_gen mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 mm = quick_select(&tm[0], (int)tm.size());
+	wm /= tm.size();
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Fixed-base mul (size " << size_class << "): `" << dec << mm << "` median cycles, `" << wm << "` avg usec" << endl;
+	cout << "+ Fixed-base simul_gen (size " << size_class << "): `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Pedersen commitment:
+ *
+ * C = a * 4 * G + b * 4 * H
+ *
+ * Commitments are additively homomorphic, so validate that
+ * 4 * commit(a1 + a2, b1 + b2) == 4 * commit(a1, b1) + 4 * commit(a2, b2)
+ */
+
+static bool ec_commit_test() {
+	// The discrete log of H is known here, which is fine for testing only
+	char x[32], H[64];
+	generate_k(x);
+	snowshoe_secret_gen(x);
+	if (snowshoe_mul_gen(x, H, 0)) {
+		return false;
+	}
+
+	// Align table memory to 64 bytes
+	const int bytes = snowshoe_fixed_base_bytes(SNOWSHOE_TABLES_SMALL);
+	vector<char> mem(bytes + 63);
+	void *table = &mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+
+	if (snowshoe_fixed_base_create(H, SNOWSHOE_TABLES_SMALL, table)) {
+		cout << "commit: snowshoe_fixed_base_create failed" << endl;
+		return false;
+	}
+
+	char one[32] = {1};
+
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char a1[32], b1[32], a2[32], b2[32], a3[32], b3[32];
+		char C1[64], C2[64], C3[64];
+
+		generate_k(a1);
+		snowshoe_secret_gen(a1);
+		generate_k(b1);
+		snowshoe_secret_gen(b1);
+		generate_k(a2);
+		snowshoe_secret_gen(a2);
+		generate_k(b2);
+		snowshoe_secret_gen(b2);
+
+		// Commit to zero the first time
+		if (iteration == 0) {
+			memset(a1, 0, 32);
+		}
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_commit(a1, b1, table, C1)) {
+			cout << "commit: snowshoe_commit failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_commit(a2, b2, table, C2)) {
+			return false;
+		}
+
+		snowshoe_add_mod_q(a1, a2, a3);
+		snowshoe_add_mod_q(b1, b2, b3);
+
+		if (snowshoe_commit(a3, b3, table, C3)) {
+			return false;
+		}
+
+		// 4 * C3 == 4 * C1 + 4 * C2
+		char R1[64], R2[64];
+		if (snowshoe_simul(one, C1, one, C2, R1)) {
+			return false;
+		}
+		if (snowshoe_mul(one, C3, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "commit: homomorphic sum mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Pedersen commit: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Cache of peer point tables:
+ *
+ * Validate snowshoe_mul_cached(k, P) == snowshoe_mul(k, P) for a pool of
+ * points larger than the cache, and that invalid points are rejected
+ * without evicting cached points
+ */
+
+static bool ec_point_cache_test() {
+	static const int POOL = 12;
+	static const int ENTRIES = 8;
+
+	// Align cache memory to 64 bytes
+	const int bytes = snowshoe_point_cache_bytes(ENTRIES);
+	if (bytes <= 0 || snowshoe_point_cache_bytes(0) != 0) {
+		cout << "point_cache: snowshoe_point_cache_bytes failed" << endl;
+		return false;
+	}
+	vector<char> mem(bytes + 63);
+	void *cache = &mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+
+	if (snowshoe_point_cache_create(ENTRIES, cache)) {
+		cout << "point_cache: snowshoe_point_cache_create failed" << endl;
+		return false;
+	}
+
+	char pool[POOL][64];
+	for (int ii = 0; ii < POOL; ++ii) {
+		char x[32];
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		if (snowshoe_mul_gen(x, pool[ii], 0)) {
+			return false;
+		}
+	}
+
+	vector<u32> ts;
+	double ws = 0;
+
+	const int iterations = 10000;
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		char k[32], R1[64], R2[64];
+
+		generate_k(k);
+		snowshoe_secret_gen(k);
+
+		// Mostly reuse the first few points
+		const char *P = pool[(iteration & 3) ? (iteration & 3) : (iteration >> 2) % POOL];
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_mul_cached(k, P, cache, R1)) {
+			cout << "point_cache: snowshoe_mul_cached failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_mul(k, P, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "point_cache: result mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	unsigned long long hits, misses;
+	snowshoe_point_cache_stats(cache, &hits, &misses);
+	if (hits + misses != (unsigned long long)iterations || hits < misses) {
+		cout << "point_cache: unexpected stats " << dec << hits << " hits, " << misses << " misses" << endl;
+		return false;
+	}
+
+	// Invalid points must fail every time
+	char k[32], bad[64], R[64];
+	generate_k(k);
+	snowshoe_secret_gen(k);
+	memcpy(bad, pool[0], 64);
+	bad[0] ^= 1;
+	for (int ii = 0; ii < 2; ++ii) {
+		if (!snowshoe_mul_cached(k, bad, cache, R)) {
+			cout << "point_cache: invalid point accepted" << endl;
+			return false;
+		}
+	}
+
+	// Invalid points must not evict cached points: Fill a single set with
+	// hot points, and check they all still hit after a rejected point
+	static const int WAYS = 4;
+	vector<char> small_mem(snowshoe_point_cache_bytes(WAYS) + 63);
+	void *small = &small_mem[(64 - ((size_t)&small_mem[0] & 63)) & 63];
+	if (snowshoe_point_cache_create(WAYS, small)) {
+		return false;
+	}
+	for (int ii = 0; ii < WAYS; ++ii) {
+		if (snowshoe_mul_cached(k, pool[ii], small, R)) {
+			return false;
+		}
+	}
+	if (!snowshoe_mul_cached(k, bad, small, R)) {
+		cout << "point_cache: invalid point accepted" << endl;
+		return false;
+	}
+	for (int ii = 0; ii < WAYS; ++ii) {
+		if (snowshoe_mul_cached(k, pool[ii], small, R)) {
+			return false;
+		}
+	}
+	unsigned long long small_hits, small_misses;
+	snowshoe_point_cache_stats(small, &small_hits, &small_misses);
+	if (small_hits != (unsigned long long)WAYS) {
+		cout << "point_cache: invalid point evicted a cached point" << endl;
+		return false;
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Mul with point cache (" << dec << (100 * hits / iterations) << "% hits): `" << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+static bool ec_point_cache_attach_test() {
+	static const int POINTS = 24;
+	static const int N = 480;
+	static const int ENTRIES = 8;
+
+	vector<char> mem(snowshoe_point_cache_bytes(ENTRIES) + 63);
+	void *cache = &mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+	if (snowshoe_point_cache_create(ENTRIES, cache)) {
+		return false;
+	}
+
+	// More points than entries, so that misses replace entries while other threads read them
+	vector<char> points(POINTS * 64), k(N * 32), P(N * 64), R(N * 64), R1(N * 64);
+	vector<int> status(N), status1(N);
+	for (int ii = 0; ii < POINTS; ++ii) {
+		char x[32];
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		if (snowshoe_mul_gen(x, &points[ii * 64], 0)) {
+			return false;
+		}
+	}
+	for (int ii = 0; ii < N; ++ii) {
+		generate_k(&k[ii * 32]);
+		snowshoe_secret_gen(&k[ii * 32]);
+		memcpy(&P[ii * 64], &points[(ii * 7 % POINTS) * 64], 64);
+	}
+	P[100 * 64 + 3] ^= 1;
+
+	if (!snowshoe_mul_batch((const char (*)[32])&k[0], (const char (*)[64])&P[0], N, (char (*)[64])&R1[0], &status1[0])) {
+		return false;
+	}
+
+	snowshoe_pool *pool = snowshoe_pool_create(4, 0);
+	if (!pool) {
+		return false;
+	}
+
+	snowshoe_point_cache_attach(cache);
+
+	// Concurrent readers and writers in the pool threads
+	for (int round = 0; round < 4; ++round) {
+		if (!snowshoe_mul_batch_parallel(pool, (const char (*)[32])&k[0], (const char (*)[64])&P[0], N, (char (*)[64])&R[0], &status[0]) ||
+			R != R1 || status != status1) {
+			cout << "point_cache: mul_batch_parallel mismatch with the cache attached" << endl;
+			return false;
+		}
+	}
+
+	if (!snowshoe_mul(&k[0], &P[100 * 64], &R[0])) {
+		cout << "point_cache: invalid point accepted with the cache attached" << endl;
+		return false;
+	}
+
+	snowshoe_point_cache_attach(0);
+	snowshoe_pool_destroy(pool);
+
+	unsigned long long hits, misses;
+	snowshoe_point_cache_stats(cache, &hits, &misses);
+	if (hits == 0 || misses == 0) {
+		cout << "point_cache: attached cache was not used" << endl;
+		return false;
+	}
+
+	// snowshoe_mul and snowshoe_simul, with room for all of their points
+	vector<char> big_mem(snowshoe_point_cache_bytes(64) + 63);
+	cache = &big_mem[(64 - ((size_t)&big_mem[0] & 63)) & 63];
+	if (snowshoe_point_cache_create(64, cache)) {
+		return false;
+	}
+	snowshoe_point_cache_attach(cache);
+
+	vector<u32> ts, ts1;
+	for (int ii = 0; ii < 200; ++ii) {
+		const char *a = &k[ii * 32], *b = &k[(ii + 1) * 32];
+		const char *Pa = &points[(ii % 4) * 64], *Qb = &points[(ii % 4 + 4) * 64];
+		char M1[64], M2[64], S1[64], S2[64];
+
+		u32 t0 = Clock::cycles();
+		if (snowshoe_simul(a, Pa, b, Qb, S1)) {
+			return false;
+		}
+		u32 t1 = Clock::cycles();
+		ts.push_back(t1 - t0);
+
+		if (snowshoe_mul(a, Pa, M1)) {
+			return false;
+		}
+
+		snowshoe_point_cache_attach(0);
+
+		t0 = Clock::cycles();
+		if (snowshoe_simul(a, Pa, b, Qb, S2)) {
+			return false;
+		}
+		t1 = Clock::cycles();
+		ts1.push_back(t1 - t0);
+
+		if (snowshoe_mul(a, Pa, M2)) {
+			return false;
+		}
+
+		snowshoe_point_cache_attach(cache);
+
+		if (memcmp(M1, M2, 64) != 0 || memcmp(S1, S2, 64) != 0) {
+			cout << "point_cache: result mismatch with the cache attached" << endl;
+			return false;
+		}
+	}
+
+	snowshoe_point_cache_attach(0);
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	u32 ms1 = quick_select(&ts1[0], (int)ts1.size());
+
+	cout << "+ Simul with point cache attached: `" << dec << ms << "` median cycles, `" << ms1 << "` without" << endl;
+
+	return true;
+}
+
+
+/*
+ * On-disk store of point tables:
+ *
+ * Validate snowshoe_mul_with_table(k, find(store, P)) == snowshoe_mul(k, P)
+ * Validate that damaged and partial entries are skipped
+ * Validate that only the store format version is checked
+ */
+
+static bool ec_store_test() {
+	static const int N = 5;
+	const char *path = "snowshoe_store_test.tmp";
+
+	remove(path);
+
+	char pool[N + 1][64];
+	for (int ii = 0; ii <= N; ++ii) {
+		char x[32];
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		if (snowshoe_mul_gen(x, pool[ii], 0)) {
+			return false;
+		}
+	}
+
+	// Missing file
+	if (snowshoe_store_open(path)) {
+		cout << "store: opened a missing file" << endl;
+		return false;
+	}
+
+	for (int ii = 0; ii < N; ++ii) {
+		if (snowshoe_store_append(path, pool[ii])) {
+			cout << "store: snowshoe_store_append failed" << endl;
+			return false;
+		}
+	}
+
+	snowshoe_table_store *store = snowshoe_store_open(path);
+	if (!store || snowshoe_store_count(store) != N) {
+		cout << "store: snowshoe_store_open failed" << endl;
+		return false;
+	}
+
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char k[32], R1[64], R2[64];
+		const char *P = pool[iteration % N];
+
+		generate_k(k);
+		snowshoe_secret_gen(k);
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		const snowshoe_point_table *table = snowshoe_store_find(store, P);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (!table || snowshoe_mul_with_table(k, table, R1)) {
+			cout << "store: lookup failed at " << iteration << endl;
+			return false;
+		}
+
+		if (snowshoe_mul(k, P, R2) || memcmp(R1, R2, 64) != 0) {
+			cout << "store: result mismatch at " << iteration << endl;
+			return false;
+		}
+	}
+
+	if (snowshoe_store_find(store, pool[N])) {
+		cout << "store: found a point that was not added" << endl;
+		return false;
+	}
+
+	snowshoe_store_close(store);
+
+	// Damage the second entry and leave a partial entry at the end
+	FILE *f = fopen(path, "r+b");
+	if (!f) {
+		return false;
+	}
+	fseek(f, 64 + 2176 + 500, SEEK_SET);
+	const int c = fgetc(f);
+	fseek(f, 64 + 2176 + 500, SEEK_SET);
+	fputc(c ^ 0x55, f);
+	fseek(f, 0, SEEK_END);
+	fwrite(pool[0], 64, 1, f);
+	fclose(f);
+
+	store = snowshoe_store_open(path);
+	if (!store || snowshoe_store_count(store) != N - 1 || snowshoe_store_find(store, pool[1])) {
+		cout << "store: damaged entry was not skipped" << endl;
+		return false;
+	}
+	snowshoe_store_close(store);
+
+	// Appending after a partial entry keeps the entries aligned
+	if (snowshoe_store_append(path, pool[N])) {
+		cout << "store: append after partial entry failed" << endl;
+		return false;
+	}
+
+	store = snowshoe_store_open(path);
+	if (!store || snowshoe_store_count(store) != N || !snowshoe_store_find(store, pool[N])) {
+		cout << "store: entry after partial entry was not found" << endl;
+		return false;
+	}
+	snowshoe_store_close(store);
+
+	// A file from another library version with the same store format is kept
+	const unsigned version = SNOWSHOE_VERSION + 1, format = SNOWSHOE_STORE_VERSION + 1;
+	f = fopen(path, "r+b");
+	if (!f) {
+		return false;
+	}
+	fseek(f, 12, SEEK_SET);
+	fwrite(&version, 4, 1, f);
+	fclose(f);
+
+	store = snowshoe_store_open(path);
+	if (!store || snowshoe_store_count(store) != N) {
+		cout << "store: file from another library version was rejected" << endl;
+		return false;
+	}
+	snowshoe_store_close(store);
+
+	// A file with another store format is rejected
+	f = fopen(path, "r+b");
+	if (!f) {
+		return false;
+	}
+	fseek(f, 8, SEEK_SET);
+	fwrite(&format, 4, 1, f);
+	fclose(f);
+
+	if (snowshoe_store_open(path)) {
+		cout << "store: file with another store format was opened" << endl;
+		return false;
+	}
+
+	remove(path);
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Point table store lookup: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Key pair for a long-lived private key:
+ *
+ * Validate snowshoe_keypair_public(kp(x)) == snowshoe_mul_gen(x)
+ * Validate snowshoe_keypair_mul(kp(x), P) == snowshoe_mul(x, P)
+ * Validate snowshoe_keypair_simul(kp(x), P, b, Q) == snowshoe_simul(x, P, b, Q)
+ * Validate snowshoe_mul_with_table(k, table(kp(x))) == snowshoe_mul(k, xG)
+ * Validate snowshoe_keypair_elligator_secret(kp(x), ...) == snowshoe_elligator_secret(x, ...)
+ */
+
+static bool ec_keypair_test() {
+	char x[32], X[64], X2[64];
+
+	// Align key pair memory to 64 bytes
+	vector<char> mem(sizeof(snowshoe_keypair) + 63);
+	snowshoe_keypair *kp = (snowshoe_keypair *)&mem[(64 - ((size_t)&mem[0] & 63)) & 63];
+
+	generate_k(x);
+	snowshoe_secret_gen(x);
+	if (snowshoe_mul_gen(x, X, 0)) {
+		return false;
+	}
+
+	if (0 == snowshoe_keypair_init(x, (snowshoe_keypair *)((char *)kp + 8))) {
+		cout << "keypair: snowshoe_keypair_init accepted misaligned memory" << endl;
+		return false;
+	}
+
+	if (snowshoe_keypair_init(x, kp)) {
+		cout << "keypair: snowshoe_keypair_init failed" << endl;
+		return false;
+	}
+
+	snowshoe_keypair_public(kp, X2);
+	if (memcmp(X, X2, 64) != 0) {
+		cout << "keypair: public key mismatch" << endl;
+		return false;
+	}
+
+	char E[128], key[32];
+	generate_k(key);
+	if (snowshoe_elligator(key, E)) {
+		return false;
+	}
+
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 10000; ++iteration) {
+		char y[32], b[32], k[32], P[64], Q[64], R1[64], R2[64];
+
+		generate_k(y);
+		snowshoe_secret_gen(y);
+		if (snowshoe_mul_gen(y, P, 0)) {
+			return false;
+		}
+		generate_k(b);
+		snowshoe_secret_gen(b);
+		if (snowshoe_mul_gen(b, Q, 0)) {
+			return false;
+		}
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_keypair_mul(kp, P, R1)) {
+			cout << "keypair: snowshoe_keypair_mul failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		if (snowshoe_mul(x, P, R2) || memcmp(R1, R2, 64) != 0) {
+			cout << "keypair: mul mismatch at " << iteration << endl;
+			return false;
+		}
+
+		if (snowshoe_keypair_simul(kp, P, b, Q, R1)) {
+			cout << "keypair: snowshoe_keypair_simul failed at " << iteration << endl;
+			return false;
+		}
+		if (snowshoe_simul(x, P, b, Q, R2) || memcmp(R1, R2, 64) != 0) {
+			cout << "keypair: simul mismatch at " << iteration << endl;
+			return false;
+		}
+
+		generate_k(k);
+		snowshoe_secret_gen(k);
+		if (snowshoe_mul_with_table(k, snowshoe_keypair_table(kp), R1)) {
+			cout << "keypair: snowshoe_mul_with_table failed at " << iteration << endl;
+			return false;
+		}
+		if (snowshoe_mul(k, X, R2) || memcmp(R1, R2, 64) != 0) {
+			cout << "keypair: public table mismatch at " << iteration << endl;
+			return false;
+		}
+
+		// Use Q as the Elligator-encrypted point
+		if (snowshoe_keypair_elligator_secret(kp, Q, E, (iteration & 1) ? b : 0, P, R1)) {
+			cout << "keypair: snowshoe_keypair_elligator_secret failed at " << iteration << endl;
+			return false;
+		}
+		if (snowshoe_elligator_secret(x, Q, E, (iteration & 1) ? b : 0, P, R2) || memcmp(R1, R2, 64) != 0) {
+			cout << "keypair: elligator secret mismatch at " << iteration << endl;
+			return false;
+		}
+	}
+
+	snowshoe_keypair_destroy(kp);
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Key pair mul: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Extended coordinate point handles:
+ *
+ * Validate store(point_mul(k, load(P))) == snowshoe_mul(k, P)
+ * Validate store(point_simul(a, load(P), b, load(Q))) == snowshoe_simul(a, P, b, Q)
+ * Validate store(4 * (load(P) + load(Q))) == snowshoe_simul(1, P, 1, Q)
+ * Validate store(load(P) + -load(P)) == identity
+ */
+
+static bool ec_point_handle_test() {
+	static const int N = 20;
+	char one[32] = {1};
+	char ident[64] = {0};
+	ident[32] = 1;
+
+	vector<u32> ts;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 1000; ++iteration) {
+		char x[32], y[32], a[32], b[32], P[64], Q[64];
+		char R[N][64], S[N][64];
+		snowshoe_point hp, hq, h[N];
+
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		generate_k(y);
+		snowshoe_secret_gen(y);
+		generate_k(a);
+		snowshoe_secret_gen(a);
+		generate_k(b);
+		snowshoe_secret_gen(b);
+
+		// The last handle tests mul_gen
+		if (snowshoe_point_mul_gen(x, &h[N - 1], 0)) {
+			cout << "point_handle: snowshoe_point_mul_gen failed at " << iteration << endl;
+			return false;
+		}
+		if (snowshoe_mul_gen(x, P, 0) || snowshoe_mul_gen(y, Q, 0)) {
+			return false;
+		}
+		memcpy(S[N - 1], P, 64);
+
+		if (snowshoe_point_load(P, &hp) || snowshoe_point_load(Q, &hq)) {
+			cout << "point_handle: snowshoe_point_load failed at " << iteration << endl;
+			return false;
+		}
+
+		// Time a mul, add, mul chain
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_point_mul(a, &hp, &h[0])) {
+			cout << "point_handle: snowshoe_point_mul failed at " << iteration << endl;
+			return false;
+		}
+		snowshoe_point_add(&h[0], &hq, &h[1]);
+		if (snowshoe_point_mul(b, &h[1], &h[1])) {
+			return false;
+		}
+		snowshoe_point_store(&h[1], 1, &R[1]);
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		ts.push_back(t1 - t0);
+		ws += s1 - s0;
+
+		// h[1] = 4 * (h[0] + Q), in place
+		snowshoe_point_add(&h[0], &hq, &h[1]);
+		snowshoe_point_dbl(&h[1], &h[1]);
+		snowshoe_point_dbl(&h[1], &h[1]);
+
+		if (snowshoe_point_simul(a, &hp, b, &hq, &h[2])) {
+			cout << "point_handle: snowshoe_point_simul failed at " << iteration << endl;
+			return false;
+		}
+
+		// h[3] = P + -P
+		snowshoe_point_neg(&hp, &h[3]);
+		snowshoe_point_add(&hp, &h[3], &h[3]);
+
+		for (int ii = 4; ii < N - 1; ++ii) {
+			snowshoe_point_add(&h[ii - 1], &hq, &h[ii]);
+		}
+
+		snowshoe_point_store(h, N, R);
+
+		// Expected results
+		if (snowshoe_mul(a, P, S[0])) {
+			return false;
+		}
+		if (snowshoe_simul(one, S[0], one, Q, S[1])) {
+			return false;
+		}
+		if (snowshoe_simul(a, P, b, Q, S[2])) {
+			return false;
+		}
+		memcpy(S[3], ident, 64);
+
+		for (int ii = 0; ii < N; ++ii) {
+			if (ii >= 4 && ii < N - 1) {
+				continue;
+			}
+			if (memcmp(R[ii], S[ii], 64) != 0) {
+				cout << "point_handle: result " << ii << " mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+
+		// h[ii] = (ii - 3) * Q for the chained additions
+		for (int ii = 4; ii < N - 1; ++ii) {
+			if (snowshoe_point_load(R[ii], &hp)) {
+				cout << "point_handle: invalid chained result at " << iteration << endl;
+				return false;
+			}
+		}
+		if (memcmp(R[4], Q, 64) != 0) {
+			cout << "point_handle: chained result mismatch at " << iteration << endl;
+			return false;
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	ws /= ts.size();
+
+	cout << "+ Point handle mul-add-mul chain: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+
+	return true;
+}
+
+/*
+ * Split simultaneous multiplication:
+ *
+ * Validate snowshoe_simul_join(half(a, P), half(b, Q)) == snowshoe_simul(a, P, b, Q)
+ *
+ * The halves run one after another here.  With two cores the latency is
+ * about the time of one half plus the join.
+ */
+
+static bool ec_simul_split_test() {
+	vector<u32> ts, tj;
+	double ws = 0;
+
+	for (int iteration = 0; iteration < 10000; ++iteration) {
+		char a[32], b[32], x[32], y[32], P[64], Q[64];
+
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		generate_k(y);
+		snowshoe_secret_gen(y);
+		if (snowshoe_mul_gen(x, P, 0) || snowshoe_mul_gen(y, Q, 0)) {
+			return false;
+		}
+
+		generate_k(a);
+		snowshoe_secret_gen(a);
+
+		// Use the same point and scalar for both halves the first time
+		if (iteration == 0) {
+			memcpy(b, a, 32);
+			memcpy(Q, P, 64);
+		} else {
+			generate_k(b);
+			snowshoe_secret_gen(b);
+		}
+
+		char H1[128], H2[128], R1[64], R2[64];
+
+		double s0 = m_clock.usec();
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_simul_half(a, P, H1)) {
+			cout << "simul_split: snowshoe_simul_half failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+		double s1 = m_clock.usec();
+
+		if (snowshoe_simul_half(b, Q, H2)) {
+			cout << "simul_split: snowshoe_simul_half failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t2 = Clock::cycles();
+
+		snowshoe_simul_join(H1, H2, R1);
+
+		u32 t3 = Clock::cycles();
+
+		ts.push_back(t1 - t0);
+		tj.push_back(t3 - t2);
+		ws += s1 - s0;
+
+		if (snowshoe_simul(a, P, b, Q, R2)) {
+			return false;
+		}
+
+		for (int ii = 0; ii < 64; ++ii) {
+			if (R1[ii] != R2[ii]) {
+				cout << "simul_split: result mismatch at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 ms = quick_select(&ts[0], (int)ts.size());
+	u32 mj = quick_select(&tj[0], (int)tj.size());
+	ws /= ts.size();
+
+	cout << "+ Split simul half: `" << dec << ms << "` median cycles, `" << ws << "` avg usec" << endl;
+	cout << "+ Split simul join: `" << dec << mj << "` median cycles" << endl;
+
+	return true;
+}
+
+/*
+ * Batch key generation:
+ *
+ * Validate that snowshoe_keygen_batch() matches snowshoe_secret_gen() and
+ * snowshoe_mul_gen() for each seed, for batches around the chunk size,
+ * and with the keys written over the seeds
+ */
+
+static bool ec_keygen_batch_test() {
+	static const int SIZES[] = {1, 2, 15, 16, 17, 33, 64};
+	static const int COUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+	vector<u32> tb, to;
+
+	for (int iteration = 0; iteration < 300; ++iteration) {
+		const int n = SIZES[iteration % COUNT];
+		vector<char> seeds(n * 32), k(n * 32), P(n * 64);
+
+		for (int ii = 0; ii < n; ++ii) {
+			generate_k(&seeds[ii * 32]);
+		}
+
+		u32 t0 = Clock::cycles();
+
+		if (snowshoe_keygen_batch((const char (*)[32])&seeds[0], n, (char (*)[32])&k[0], (char (*)[64])&P[0])) {
+			cout << "keygen_batch: snowshoe_keygen_batch failed at " << iteration << endl;
+			return false;
+		}
+
+		u32 t1 = Clock::cycles();
+
+		for (int ii = 0; ii < n; ++ii) {
+			char k1[32], P1[64];
+			memcpy(k1, &seeds[ii * 32], 32);
+
+			u32 t2 = Clock::cycles();
+
+			snowshoe_secret_gen(k1);
+			if (snowshoe_mul_gen(k1, P1, 0)) {
+				return false;
+			}
+
+			u32 t3 = Clock::cycles();
+
+			if (n == 64) {
+				to.push_back(t3 - t2);
+			}
+
+			if (memcmp(k1, &k[ii * 32], 32) != 0 || memcmp(P1, &P[ii * 64], 64) != 0) {
+				cout << "keygen_batch: key mismatch at " << iteration << " key " << ii << endl;
+				return false;
+			}
+		}
+
+		if (n == 64) {
+			tb.push_back((t1 - t0) / n);
+		}
+
+		// Keys written over the seeds
+		if (snowshoe_keygen_batch((const char (*)[32])&seeds[0], n, (char (*)[32])&seeds[0], (char (*)[64])&P[0]) ||
+			memcmp(&seeds[0], &k[0], n * 32) != 0) {
+			cout << "keygen_batch: in-place keys mismatch at " << iteration << endl;
+			return false;
+		}
+	}
+
+	u32 mb = quick_select(&tb[0], (int)tb.size());
+	u32 mo = quick_select(&to[0], (int)to.size());
+
+	cout << "+ snowshoe_keygen_batch (64 keys): `" << dec << mb << "` median cycles per key" << endl;
+	cout << "+ snowshoe_secret_gen + snowshoe_mul_gen: `" << dec << mo << "` median cycles per key" << endl;
+
+	return true;
+}
+
+/*
+ * Batch variable-base multiplication:
+ *
+ * Validate that snowshoe_mul_batch() matches snowshoe_mul() for each entry
+ * Validate that invalid scalars and points are reported per entry
+ */
+
+static bool ec_mul_batch_test() {
+	static const int N = 40;
+
+	vector<u32> tb, to;
+
+	for (int iteration = 0; iteration < 200; ++iteration) {
+		char k[N][32], P[N][64], R[N][64], x[32];
+		int status[N];
+
+		for (int ii = 0; ii < N; ++ii) {
+			generate_k(k[ii]);
+			snowshoe_secret_gen(k[ii]);
+			generate_k(x);
+			snowshoe_secret_gen(x);
+			if (snowshoe_mul_gen(x, P[ii], 0)) {
+				return false;
+			}
+		}
+
+		// Break a point and a scalar in half of the runs
+		const int bad_point = iteration % N;
+		const int bad_key = (iteration * 7 + 3) % N;
+		const bool broken = (iteration & 1) != 0;
+		if (broken) {
+			P[bad_point][iteration % 64] ^= 1;
+			memset(k[bad_key], 0, 32);
+		}
+
+		u32 t0 = Clock::cycles();
+
+		const int result = snowshoe_mul_batch(k, P, N, R, status);
+
+		u32 t1 = Clock::cycles();
+
+		if ((result != 0) != broken) {
+			cout << "mul_batch: wrong return value at " << iteration << endl;
+			return false;
+		}
+
+		if (!broken) {
+			tb.push_back((t1 - t0) / N);
+		}
+
+		for (int ii = 0; ii < N; ++ii) {
+			char R1[64];
+
+			u32 t2 = Clock::cycles();
+
+			const int expected = snowshoe_mul(k[ii], P[ii], R1);
+
+			u32 t3 = Clock::cycles();
+
+			if (!broken) {
+				to.push_back(t3 - t2);
+			}
+
+			if ((status[ii] != 0) != (expected != 0)) {
+				cout << "mul_batch: wrong status for entry " << ii << " at " << iteration << endl;
+				return false;
+			}
+
+			if (expected == 0 && memcmp(R[ii], R1, 64) != 0) {
+				cout << "mul_batch: result mismatch for entry " << ii << " at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 mb = quick_select(&tb[0], (int)tb.size());
+	u32 mo = quick_select(&to[0], (int)to.size());
+
+	cout << "+ snowshoe_mul_batch (40 entries): `" << dec << mb << "` median cycles per entry" << endl;
+	cout << "+ snowshoe_mul: `" << dec << mo << "` median cycles" << endl;
+
+	return true;
+}
+
+/*
+ * Batch Elligator:
+ *
+ * Validate that snowshoe_elligator_batch() matches snowshoe_elligator() for
+ * each key, including the all-zero and all-ones keys, over a batch that
+ * does not fill the last chunk
+ */
+
+static bool ec_elligator_batch_test() {
+	static const int N = 40;
+
+	vector<u32> tb, to;
+
+	for (int iteration = 0; iteration < 200; ++iteration) {
+		char keys[N][32], E[N][128];
+		int status[N];
+
+		for (int ii = 0; ii < N; ++ii) {
+			generate_k(keys[ii]);
+		}
+		if (iteration == 0) {
+			memset(keys[3], 0, 32);
+			memset(keys[20], 0xff, 32);
+		}
+
+		u32 t0 = Clock::cycles();
+
+		snowshoe_elligator_batch(keys, N, E, status);
+
+		u32 t1 = Clock::cycles();
+
+		tb.push_back((t1 - t0) / N);
+
+		for (int ii = 0; ii < N; ++ii) {
+			char E1[128];
+
+			u32 t2 = Clock::cycles();
+
+			const int expected = snowshoe_elligator(keys[ii], E1);
+
+			u32 t3 = Clock::cycles();
+
+			to.push_back(t3 - t2);
+
+			if ((status[ii] != 0) != (expected != 0)) {
+				cout << "elligator_batch: wrong status for key " << ii << " at " << iteration << endl;
+				return false;
+			}
+
+			if (expected == 0 && memcmp(E[ii], E1, 128) != 0) {
+				cout << "elligator_batch: result mismatch for key " << ii << " at " << iteration << endl;
+				return false;
+			}
+		}
+	}
+
+	u32 mb = quick_select(&tb[0], (int)tb.size());
+	u32 mo = quick_select(&to[0], (int)to.size());
+
+	cout << "+ snowshoe_elligator_batch (40 keys): `" << dec << mb << "` median cycles per key" << endl;
+	cout << "+ snowshoe_elligator: `" << dec << mo << "` median cycles" << endl;
+
+	return true;
+}
+
+/*
+ * Thread pool:
+ *
+ * Validate that the _parallel batch functions match the serial ones,
+ * including per-entry failures, for batches that do not fill the last chunk,
+ * and that snowshoe_simul_parallel() matches snowshoe_simul().
+ * Validate that a processor list needs an explicit thread count
+ */
+
+static bool ec_pool_test() {
+	static const int N = 1000;
+
+	// Processor list without its length
+	const int cpus[1] = {0};
+	if (snowshoe_pool_create(0, cpus)) {
+		cout << "pool: snowshoe_pool_create accepted cpus without threads" << endl;
+		return false;
+	}
+
+	snowshoe_pool *pool = snowshoe_pool_create(4, 0);
+	if (!pool) {
+		cout << "pool: snowshoe_pool_create failed" << endl;
+		return false;
+	}
+
+	vector<char> seeds(N * 32), k(N * 32), k1(N * 32), P(N * 64), P1(N * 64), R(N * 64), R1(N * 64);
+	vector<char> sig(N * 96);
+	vector<snowshoe_iovec> msg(N);
+	vector<int> status(N), status1(N);
+
+	for (int ii = 0; ii < N * 32; ++ii) {
+		seeds[ii] = (char)rand();
+	}
+
+	// Key generation
+	double s0 = m_clock.usec();
+	if (snowshoe_keygen_batch_parallel(pool, (const char (*)[32])&seeds[0], N, (char (*)[32])&k[0], (char (*)[64])&P[0])) {
+		cout << "pool: snowshoe_keygen_batch_parallel failed" << endl;
+		return false;
+	}
+	double s1 = m_clock.usec();
+	if (snowshoe_keygen_batch((const char (*)[32])&seeds[0], N, (char (*)[32])&k1[0], (char (*)[64])&P1[0])) {
+		return false;
+	}
+	double s2 = m_clock.usec();
+	if (k != k1 || P != P1) {
+		cout << "pool: keygen mismatch" << endl;
+		return false;
+	}
+
+	cout << "+ snowshoe_keygen_batch_parallel (1000 keys, 4 threads): `" << (s1 - s0) << "` usec, serial `" << (s2 - s1) << "` usec" << endl;
+
+	// Diffie-Hellman with a few bad entries
+	P1 = P;
+	for (int ii = 0; ii < N; ii += 97) {
+		P1[ii * 64 + 5] ^= 1;
+	}
+	memset(&k[333 * 32], 0, 32);
+
+	int r0 = snowshoe_mul_batch_parallel(pool, (const char (*)[32])&k[0], (const char (*)[64])&P1[0], N, (char (*)[64])&R[0], &status[0]);
+	int r1 = snowshoe_mul_batch((const char (*)[32])&k[0], (const char (*)[64])&P1[0], N, (char (*)[64])&R1[0], &status1[0]);
+	if (r0 == 0 || r1 == 0 || R != R1 || status != status1) {
+		cout << "pool: mul_batch mismatch" << endl;
+		return false;
+	}
+
+	// Signatures with a few bad entries
+	for (int ii = 0; ii < N; ++ii) {
+		char sk[64];
+		if (snowshoe_sign_keygen(&seeds[ii * 32], sk, &P[ii * 64])) {
+			return false;
+		}
+		msg[ii].data = &seeds[0];
+		msg[ii].bytes = ii % 100;
+		if (snowshoe_sign(sk, &P[ii * 64], msg[ii].data, msg[ii].bytes, &sig[ii * 96])) {
+			return false;
+		}
+	}
+	for (int ii = 5; ii < N; ii += 101) {
+		sig[ii * 96 + ii % 96] ^= 2;
+	}
+
+	r0 = snowshoe_verify_batch_parallel(pool, (const char (*)[64])&P[0], &msg[0], (const char (*)[96])&sig[0], N, &status[0]);
+	r1 = snowshoe_verify_batch_parallel(0, (const char (*)[64])&P[0], &msg[0], (const char (*)[96])&sig[0], N, &status1[0]);
+	if (r0 == 0 || r1 == 0 || status != status1) {
+		cout << "pool: verify_batch mismatch" << endl;
+		return false;
+	}
+	for (int ii = 0; ii < N; ++ii) {
+		const bool bad = ii >= 5 && (ii - 5) % 101 == 0;
+		if ((status[ii] != 0) != bad) {
+			cout << "pool: wrong verify status for entry " << ii << endl;
+			return false;
+		}
+	}
+
+	// Split simul, including a bad point in either half
+	vector<u32> tp;
+	for (int ii = 0; ii < 200; ++ii) {
+		// Past the zeroed key at 333
+		const int jj = 400 + ii * 2;
+		const char *a = &k[jj * 32], *b = &k[(jj + 1) * 32];
+		const char *Pa = &P[jj * 64], *Qb = &P[(jj + 1) * 64];
+		char R0[64], R2[64];
+
+		u32 t0 = Clock::cycles();
+		if (snowshoe_simul_parallel(pool, a, Pa, b, Qb, R0)) {
+			cout << "pool: snowshoe_simul_parallel failed" << endl;
+			return false;
+		}
+		u32 t1 = Clock::cycles();
+		tp.push_back(t1 - t0);
+
+		if (snowshoe_simul(a, Pa, b, Qb, R2) || memcmp(R0, R2, 64) != 0) {
+			cout << "pool: simul_parallel mismatch" << endl;
+			return false;
+		}
+		if (snowshoe_simul_parallel(0, a, Pa, b, Qb, R0) || memcmp(R0, R2, 64) != 0) {
+			cout << "pool: simul_parallel without a pool mismatch" << endl;
+			return false;
+		}
+		if (!snowshoe_simul_parallel(pool, a, &P1[0], b, Qb, R0) || !snowshoe_simul_parallel(pool, a, Pa, b, &P1[0], R0)) {
+			cout << "pool: simul_parallel accepted a bad point" << endl;
+			return false;
+		}
+	}
+
+	cout << "+ snowshoe_simul_parallel (4 threads): `" << dec << quick_select(&tp[0], (int)tp.size()) << "` median cycles" << endl;
+
+	snowshoe_pool_destroy(pool);
+
+	return true;
+}
+
+/*
+ * Job queue:
+ *
+ * Simulate an event loop that keeps the queue topped up with a mix of
+ * jobs, some with invalid inputs, waits on the queue descriptor, and
+ * checks each finished job against the direct call
+ */
+
+static bool ec_queue_test() {
+	static const int JOBS = 2000;
+	static const int CAPACITY = 64;
+
+	snowshoe_queue *queue = snowshoe_queue_create(2, CAPACITY);
+	if (!queue) {
+		cout << "queue: snowshoe_queue_create failed" << endl;
+		return false;
+	}
+
+	vector<snowshoe_job> jobs(JOBS);
+	for (int ii = 0; ii < JOBS; ++ii) {
+		snowshoe_job &job = jobs[ii];
+		char x[32];
+
+		job.op = SNOWSHOE_OP_MUL_GEN + ii % 3;
+		job.user = &job;
+		generate_k(job.a);
+		snowshoe_secret_gen(job.a);
+		generate_k(job.b);
+		snowshoe_secret_gen(job.b);
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		snowshoe_mul_gen(x, job.P, 0);
+		generate_k(x);
+		snowshoe_secret_gen(x);
+		snowshoe_mul_gen(x, job.Q, 0);
+
+		// Invalid point or scalar
+		if (ii % 37 == 1) {
+			job.P[ii % 64] ^= 1;
+		} else if (ii % 37 == 2) {
+			memset(job.a, 0, 32);
+		}
+	}
+
+	int submitted = 0, collected = 0, wakeups = 0;
+
+	while (collected < JOBS) {
+		// Top up the queue until it is full
+		while (submitted < JOBS && snowshoe_submit(queue, &jobs[submitted]) == 0) {
+			++submitted;
+		}
+
+#if !defined(CAT_OS_WINDOWS)
+		// Wait for the descriptor as an event loop would
+		struct pollfd pfd;
+		pfd.fd = snowshoe_queue_fd(queue);
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10000) != 1) {
+			cout << "queue: descriptor did not become readable" << endl;
+			return false;
+		}
+		++wakeups;
+#endif
+
+		snowshoe_job *done[16];
+		const int n = snowshoe_poll(queue, done, 16);
+
+		for (int ii = 0; ii < n; ++ii) {
+			const snowshoe_job &job = *done[ii];
+			char R[64];
+			int expected;
+
+			if (job.user != done[ii]) {
+				cout << "queue: user pointer changed" << endl;
+				return false;
+			}
+
+			switch (job.op) {
+			case SNOWSHOE_OP_MUL_GEN: expected = snowshoe_mul_gen(job.a, R, 0); break;
+			case SNOWSHOE_OP_MUL: expected = snowshoe_mul(job.a, job.P, R); break;
+			default: expected = snowshoe_simul(job.a, job.P, job.b, job.Q, R); break;
+			}
+
+			if ((job.result != 0) != (expected != 0) || (expected == 0 && memcmp(job.R, R, 64) != 0)) {
+				cout << "queue: result mismatch for job " << (done[ii] - &jobs[0]) << endl;
+				return false;
+			}
+		}
+
+		collected += n;
+	}
+
+	// Nothing is left to collect
+	snowshoe_job *done[1];
+	if (snowshoe_poll(queue, done, 1) != 0) {
+		return false;
+	}
+
+	snowshoe_queue_destroy(queue);
+
+	cout << "+ snowshoe_queue: " << JOBS << " jobs collected in " << wakeups << " wakeups" << endl;
+
+	return true;
+}
+
+/*
+ * Ephemeral key pool:
+ *
+ * Simulate handshakes that each take a key pair and then do a key
+ * agreement, so the background thread has time to refill.  Every pair
+ * must match snowshoe_mul_gen(), and none may be handed out twice.
+ */
+
+// Fails if the context is not null
+static int ephemeral_random(void *context, char *buf, int bytes) {
+	if (context) {
+		return -1;
+	}
+
+	for (int ii = 0; ii < bytes; ii += 32) {
+		char k[32];
+		generate_k(k);
+		memcpy(buf + ii, k, bytes - ii < 32 ? bytes - ii : 32);
+	}
+
+	return 0;
+}
+
+static bool ec_ephemeral_test() {
+	static const int HANDSHAKES = 500;
+
+	// Parameters out of range
+	if (snowshoe_ephemeral_create(64, 64, ephemeral_random, 0) ||
+		snowshoe_ephemeral_create(0, 0, ephemeral_random, 0) ||
+		snowshoe_ephemeral_create(64, 16, 0, 0)) {
+		cout << "ephemeral: bad parameters accepted" << endl;
+		return false;
+	}
+
+	snowshoe_ephemeral *pool = snowshoe_ephemeral_create(64, 16, ephemeral_random, 0);
+	if (!pool) {
+		cout << "ephemeral: snowshoe_ephemeral_create failed" << endl;
+		return false;
+	}
+
+	vector<u32> ts;
+	vector<char> keys(HANDSHAKES * 32);
+	char P[64], Q[64], R[64];
+
+	generate_k(R);
+	snowshoe_secret_gen(R);
+	snowshoe_mul_gen(R, Q, 0);
+
+	for (int ii = 0; ii < HANDSHAKES; ++ii) {
+		char *k = &keys[ii * 32];
+
+		u32 t0 = Clock::cycles();
+		if (snowshoe_ephemeral_pop(pool, k, P)) {
+			cout << "ephemeral: snowshoe_ephemeral_pop failed" << endl;
+			return false;
+		}
+		u32 t1 = Clock::cycles();
+
+		ts.push_back(t1 - t0);
+
+		if (snowshoe_mul_gen(k, R, 0) || memcmp(P, R, 64) != 0) {
+			cout << "ephemeral: pair mismatch at " << ii << endl;
+			return false;
+		}
+
+		for (int jj = 0; jj < ii; ++jj) {
+			if (memcmp(k, &keys[jj * 32], 32) == 0) {
+				cout << "ephemeral: pair " << ii << " repeats pair " << jj << endl;
+				return false;
+			}
+		}
+
+		// Rest of the handshake
+		snowshoe_mul(k, Q, R);
+	}
+
+	unsigned long long hits, misses;
+	snowshoe_ephemeral_stats(pool, &hits, &misses);
+	snowshoe_ephemeral_destroy(pool);
+
+	if (hits + misses != HANDSHAKES) {
+		cout << "ephemeral: stats do not add up" << endl;
+		return false;
+	}
+
+	// A failing random source is reported once the pool is empty
+	pool = snowshoe_ephemeral_create(4, 0, ephemeral_random, &hits);
+	if (!pool || snowshoe_ephemeral_pop(pool, &keys[0], P) == 0) {
+		cout << "ephemeral: random source failure not reported" << endl;
+		return false;
+	}
+	snowshoe_ephemeral_destroy(pool);
+
+	u32 median = quick_select(&ts[0], (int)ts.size());
+
+	cout << "+ snowshoe_ephemeral_pop: `" << dec << median << "` median cycles (" << hits << " of " << HANDSHAKES << " from the pool)" << endl;
+
+	return true;
+}
+
+//// Entrypoint
+
+static void tscTime() {
+	const u32 c0 = Clock::cycles();
+	const double t0 = m_clock.usec();
+	const double t_end = t0 + 1000000.0;
+
+	double t;
+	u32 c;
+	do {
+		c = Clock::cycles();
+		t = m_clock.usec();
+	} while (t < t_end);
+
+	cout << "RDTSC instruction runs at " << (c - c0)/(t - t0)/1000.0 << " GHz" << endl;
+}
+
+int main() {
+	cout << "Snowshoe Unit Tester" << endl;
+
+#ifdef CAT_SNOWSHOE_VECTOR_OPT
+	cout << "Using vector extensions for table lookups! <3" << endl;
+#endif
+
+#ifdef CAT_SNOWSHOE_AVX2
+	cout << "Using AVX2 for table lookups" << endl;
+#endif
+
+	// Note that assert() should not be used for crypto code since it is often compiled
+	// out in release mode.  It is only used here for testing.
+
+	m_clock.OnInitialize();
+
+	tscTime();
+
+	srand(0);
+
+	// Example of verifying API level on startup:
+
+	double t0 = m_clock.usec();
+	if (snowshoe_init()) {
+		throw "Wrong snowshoe static library is linked";
+	}
+	double t1 = m_clock.usec();
+	cout << "snowshoe_init() ran in " << (t1 - t0) << " usec" << endl;
+
+	assert(ec_elligator_test());
+	assert(ec_dh_test());
+	assert(ec_dh_fs_test());
+	assert(ec_dsa_test());
+	assert(ec_sign_test());
+	assert(ec_sign_stream_test());
+	assert(ec_simul_n_test(3));
+	assert(ec_simul_n_test(4));
+	assert(ec_point_table_test());
+	assert(ec_fixed_base_test(SNOWSHOE_TABLES_SMALL));
+	assert(ec_fixed_base_test(SNOWSHOE_TABLES_LARGE));
+	assert(ec_commit_test());
+	assert(ec_point_cache_test());
+	assert(ec_point_cache_attach_test());
+	assert(ec_store_test());
+	assert(ec_simul_split_test());
+	assert(ec_keypair_test());
+	assert(ec_point_handle_test());
+	assert(ec_keygen_batch_test());
+	assert(ec_mul_batch_test());
+	assert(ec_elligator_batch_test());
+	assert(ec_pool_test());
+	assert(ec_queue_test());
+	assert(ec_ephemeral_test());
+
+	t0 = m_clock.usec();
+	if (snowshoe_init_tables(SNOWSHOE_TABLES_LARGE)) {
+		throw "Unable to build large tables";
+	}
+	t1 = m_clock.usec();
+	cout << "snowshoe_init_tables(SNOWSHOE_TABLES_LARGE) ran in " << (t1 - t0) << " usec" << endl;
+
+	assert(ec_elligator_test());
+	assert(ec_dh_test());
+	assert(ec_dh_fs_test());
+	assert(ec_dsa_test());
+
+	assert(0 == snowshoe_init_tables(SNOWSHOE_TABLES_SMALL));
+
+	// Switching back reuses the tables that were already built
+	assert(0 == snowshoe_init_tables(SNOWSHOE_TABLES_LARGE));
 	assert(ec_dsa_test());
+	assert(0 == snowshoe_init_tables(SNOWSHOE_TABLES_SMALL));
 
 	cout << "All tests passed successfully." << endl;
 